@@ -0,0 +1,108 @@
+#include "Corpus.hpp"
+#include <random>
+using namespace std;
+
+namespace clex::bench {
+
+    namespace {
+
+        const char* const kWords[] = {
+            "buffer", "length", "index", "node", "next", "prev", "count", "state", "value", "result",
+            "client", "server", "socket", "request", "response", "header", "path", "offset", "size", "data"
+        };
+
+        const char* const kTypes[] = { "int", "char", "unsigned", "size_t", "struct node", "const char*", "long", "double" };
+
+        template <class T, size_t N>
+        const T& Pick(mt19937& rng, const T (&items)[N]) { return items[rng() % N]; }
+
+        string Identifier(mt19937& rng) {
+            string id = Pick(rng, kWords);
+            if (rng() % 2) { id += '_'; id += Pick(rng, kWords); }
+            if (rng() % 3 == 0) id += to_string(rng() % 100);
+            return id;
+        }
+
+    }
+
+    string MakeIdentifierHeavy(size_t bytes, uint32_t seed) {
+        mt19937 rng(seed);
+        string out;
+        out.reserve(bytes + 256);
+
+        while (out.size() < bytes) {
+            out += "    ";
+            out += Pick(rng, kTypes);
+            out += ' ';
+            out += Identifier(rng);
+            out += " = ";
+            out += Identifier(rng);
+            out += "->";
+            out += Identifier(rng);
+            out += " + ";
+            out += Identifier(rng);
+            out += '(';
+            out += Identifier(rng);
+            out += ", ";
+            out += Identifier(rng);
+            out += ");\n";
+            if (rng() % 8 == 0) out += "    if (" + Identifier(rng) + " && !" + Identifier(rng) + ") return " + Identifier(rng) + ";\n";
+        }
+        return out;
+    }
+
+    string MakeCommentHeavy(size_t bytes, uint32_t seed) {
+        mt19937 rng(seed);
+        string out;
+        out.reserve(bytes + 512);
+
+        while (out.size() < bytes) {
+            switch (rng() % 3) {
+            case 0:
+                out += "/*\n";
+                for (unsigned i = 0, n = 2 + rng() % 8; i < n; ++i) {
+                    out += " * The " + Identifier(rng) + " keeps track of the " + Identifier(rng) + " for every " + Identifier(rng) + ".\n";
+                }
+                out += " */\n";
+                break;
+            case 1:
+                out += "// " + Identifier(rng) + ": see the notes about " + Identifier(rng) + " and " + Identifier(rng) + " above\n";
+                break;
+            default:
+                out += "int " + Identifier(rng) + "; /* " + Identifier(rng) + " */\n";
+                break;
+            }
+        }
+        return out;
+    }
+
+    string MakeLiteralHeavy(size_t bytes, uint32_t seed) {
+        mt19937 rng(seed);
+        string out;
+        out.reserve(bytes + 256);
+
+        while (out.size() < bytes) {
+            out += "    { \"" + Identifier(rng) + " \\\"" + Identifier(rng) + "\\\"\\n\", '";
+            out += static_cast<char>('a' + rng() % 26);
+            out += "', '\\t', ";
+            out += to_string(rng() % 100000);
+            out += ", 0x" + to_string(rng() % 0xFFFF) + "u, ";
+            out += to_string(rng() % 1000) + "." + to_string(rng() % 1000) + "e-" + to_string(rng() % 10) + "f, ";
+            out += to_string(rng() % 100) + "UL },\n";
+        }
+        return out;
+    }
+
+    string MakeScaledMix(const string& sample, size_t bytes) {
+        string out;
+        if (sample.empty()) return out;
+
+        out.reserve(bytes + sample.size());
+        while (out.size() < bytes) {
+            out += sample;
+            out += '\n';
+        }
+        return out;
+    }
+
+}
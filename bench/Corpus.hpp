@@ -0,0 +1,22 @@
+#pragma once
+#include <cstdint>
+#include <string>
+#include <vector>
+using namespace std;
+
+namespace clex::bench {
+
+    struct Corpus {
+        string name;
+        string text;
+    };
+
+    // Deterministic synthetic C sources of roughly `bytes` bytes each.
+    string MakeIdentifierHeavy(size_t bytes, uint32_t seed);
+    string MakeCommentHeavy(size_t bytes, uint32_t seed);
+    string MakeLiteralHeavy(size_t bytes, uint32_t seed);
+
+    // `sample` repeated until it reaches `bytes`.
+    string MakeScaledMix(const string& sample, size_t bytes);
+
+}
@@ -0,0 +1,341 @@
+#include <algorithm>
+#include <chrono>
+#include <charconv>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <memory_resource>
+#include <sstream>
+#ifdef _WIN32
+#include <windows.h>
+#include <psapi.h>
+#else
+#include <sys/resource.h>
+#endif
+#include "Corpus.hpp"
+#include "lexer/BasicLexer.hpp"
+#include "lexer/DependencyScan.hpp"
+#include "lexer/Lexer.hpp"
+#include "lexer/SymbolTable.hpp"
+#include "lexer/ThreadPool.hpp"
+#include "lexer/Token.hpp"
+#include "lexer/TokenRange.hpp"
+#include "lexer/Utf8.hpp"
+using namespace std;
+using namespace clex::bench;
+
+#ifndef CLEX_EXAMPLES_DIR
+#define CLEX_EXAMPLES_DIR "examples"
+#endif
+
+struct BenchOptions {
+    size_t bytes = 8 << 20;
+    size_t repeats = 5;
+    size_t jobs = 0;
+    bool   regex = false;
+    bool   scaling = false;
+    string sample = CLEX_EXAMPLES_DIR "/web_server.c";
+    string out;
+};
+
+struct Measurement {
+    string corpus;
+    string mode;
+    size_t bytes = 0;
+    size_t tokens = 0;
+    double seconds = 0;
+    bool   perToken = true;    // false when `tokens` counts something else, or nothing
+};
+
+static void PrintUsage(const char* argv0) {
+    cerr << "Usage: " << argv0 << " [--size=MB] [--repeat=N] [--regex] [--scaling] [--jobs=N]\n"
+        << "       " << string(strlen(argv0), ' ') << " [--sample=file.c] [--out=results.json]\n";
+}
+
+static bool ParseCount(string_view text, size_t& value) {
+    auto [end, ec] = from_chars(text.data(), text.data() + text.size(), value);
+    return ec == errc() && end == text.data() + text.size();
+}
+
+static size_t PeakRssBytes() {
+#ifdef _WIN32
+    PROCESS_MEMORY_COUNTERS counters{};
+    if (!GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters))) return 0;
+    return counters.PeakWorkingSetSize;
+#else
+    rusage usage{};
+    if (getrusage(RUSAGE_SELF, &usage) != 0) return 0;
+#ifdef __APPLE__
+    return static_cast<size_t>(usage.ru_maxrss);
+#else
+    return static_cast<size_t>(usage.ru_maxrss) * 1024;
+#endif
+#endif
+}
+
+// Median of `repeats` runs after one untimed warm-up; `run` returns the token count.
+template <class Run>
+static Measurement Time(const string& corpus, const string& mode, const string& text, size_t repeats, Run run) {
+    Measurement m{ corpus, mode, text.size() };
+    m.tokens = run();
+
+    vector<double> samples;
+    for (size_t i = 0; i < repeats; ++i) {
+        auto t0 = chrono::steady_clock::now();
+        size_t tokens = run();
+        samples.push_back(chrono::duration<double>(chrono::steady_clock::now() - t0).count());
+        if (tokens != m.tokens) cerr << "warning: " << corpus << "/" << mode << " token count changed between runs\n";
+    }
+
+    sort(samples.begin(), samples.end());
+    m.seconds = samples[samples.size() / 2];
+    return m;
+}
+
+static void MeasureCorpus(const Corpus& corpus, const BenchOptions& bench, vector<Measurement>& out) {
+    const string& text = corpus.text;
+
+    out.push_back(Time(corpus.name, "TokenizeAll", text, bench.repeats, [&] {
+        clex::Lexer lexer{ string_view(text) };
+        return lexer.TokenizeAll().size();
+    }));
+
+    out.push_back(Time(corpus.name, "TokenizeAll/pmr", text, bench.repeats, [&] {
+        pmr::monotonic_buffer_resource arena;
+        clex::Lexer lexer{ string_view(text) };
+        return lexer.TokenizeAll(&arena).size();
+    }));
+
+    out.push_back(Time(corpus.name, "GetNextToken", text, bench.repeats, [&] {
+        clex::Lexer lexer{ string_view(text) };
+        size_t count = 0;
+        while (true) {
+            clex::Token t = lexer.GetNextToken();
+            ++count;
+            if (t.kind == clex::TokenKind::EndOfFile || t.kind == clex::TokenKind::Error) break;
+        }
+        return count;
+    }));
+
+    out.push_back(Time(corpus.name, "NextBatch/256", text, bench.repeats, [&] {
+        clex::Lexer lexer{ string_view(text) };
+        vector<clex::Token> buffer(256);
+        size_t count = 0;
+        while (size_t n = lexer.NextBatch(buffer.data(), buffer.size())) count += n;
+        return count;
+    }));
+
+    out.push_back(Time(corpus.name, "Tokens", text, bench.repeats, [&] {
+        clex::Lexer lexer{ string_view(text) };
+        size_t count = 0;
+        for ([[maybe_unused]] const clex::Token& t : lexer.Tokens()) ++count;
+        return count;
+    }));
+
+    // Counts directives rather than tokens; compare by MB/s.
+    out.push_back(Time(corpus.name, "ScanDependencies", text, bench.repeats, [&] {
+        return clex::ScanDependencies(text).directives.size();
+    }));
+    out.back().perToken = false;
+
+    // Counts nothing; compare by MB/s.
+    out.push_back(Time(corpus.name, "FindInvalidUtf8", text, bench.repeats, [&] {
+        return clex::FindInvalidUtf8(text) == string_view::npos ? size_t(0) : size_t(1);
+    }));
+    out.back().perToken = false;
+
+    out.push_back(Time(corpus.name, "BasicLexer<CountingPolicy>", text, bench.repeats, [&] {
+        clex::TokenHistogram counts = clex::BasicLexer<clex::CountingPolicy>{ string_view(text) }.CountKinds();
+        size_t total = 0;
+        for (size_t n : counts) total += n;
+        return total;
+    }));
+
+    out.push_back(Time(corpus.name, "TokenizeAllCompact", text, bench.repeats, [&] {
+        clex::Lexer lexer{ string_view(text) };
+        return lexer.TokenizeAllCompact().tokens.size();
+    }));
+
+    clex::LexerOptions untracked;
+    untracked.trackPositions = false;
+
+    out.push_back(Time(corpus.name, "TokenizeAllCompact/offsets", text, bench.repeats, [&] {
+        clex::Lexer lexer(string_view(text), untracked);
+        return lexer.TokenizeAllCompact().tokens.size();
+    }));
+
+    out.push_back(Time(corpus.name, "TokenizeAllCompact/LineIndex", text, bench.repeats, [&] {
+        clex::Lexer lexer(string_view(text), untracked);
+        clex::CompactTokenStream stream = lexer.TokenizeAllCompact();
+        lexer.Lines().Annotate(stream);
+        return stream.tokens.size();
+    }));
+
+    out.push_back(Time(corpus.name, "TokenizeAllCompact/interned", text, bench.repeats, [&] {
+        clex::SymbolTable symbols;
+        clex::LexerOptions interned;
+        interned.symbols = &symbols;
+        clex::Lexer lexer(string_view(text), interned);
+        return lexer.TokenizeAllCompact().tokens.size();
+    }));
+
+    if (bench.regex) {
+        out.push_back(Time(corpus.name, "TokenizeAll/regex", text, 1, [&] {
+            clex::Lexer lexer(string_view(text), { clex::ScanEngine::Regex });
+            return lexer.TokenizeAll().size();
+        }));
+    }
+}
+
+// Re-lexes every kind in isolation: the lexemes of one kind from `text`, one per
+// line, so each kind's cost can be read off without the others diluting it.
+static void MeasureKinds(const string& text, size_t repeats, vector<Measurement>& out) {
+    clex::Lexer lexer{ string_view(text) };
+    clex::CompactTokenStream stream = lexer.TokenizeAllCompact();
+
+    map<string, string> byKind;
+    for (const clex::CompactToken& t : stream.tokens) {
+        if (t.Kind() == clex::TokenKind::EndOfFile || t.Kind() == clex::TokenKind::Error) continue;
+        string& kindText = byKind[clex::to_string(t.Kind())];
+        kindText += stream.Lexeme(t);
+        kindText += '\n';
+    }
+
+    for (const auto& [kind, kindText] : byKind) {
+        out.push_back(Time(kind, "TokenizeAllCompact", kindText, repeats, [&] {
+            clex::Lexer kindLexer{ string_view(kindText) };
+            return kindLexer.TokenizeAllCompact().tokens.size() - 1;
+        }));
+    }
+}
+
+static void MeasureScaling(const Corpus& corpus, const BenchOptions& bench, vector<Measurement>& out) {
+    size_t maxThreads = bench.jobs ? bench.jobs : clex::ThreadPool::DefaultSize();
+    for (size_t threads = 1; ; threads = min(threads * 2, maxThreads)) {
+        clex::ThreadPool pool(threads);
+        out.push_back(Time(corpus.name, "TokenizeAllParallel/" + to_string(threads), corpus.text, bench.repeats, [&] {
+            clex::Lexer lexer{ string_view(corpus.text) };
+            return lexer.TokenizeAllParallel(pool).tokens.size();
+        }));
+        if (threads == maxThreads) break;
+    }
+}
+
+static void AppendJsonString(string& out, string_view text) {
+    out += '"';
+    for (char c : text) {
+        if (c == '"' || c == '\\') out += '\\';
+        out += c;
+    }
+    out += '"';
+}
+
+static void AppendMeasurements(string& out, const char* key, const vector<Measurement>& measurements) {
+    out += "  \"";
+    out += key;
+    out += "\": [";
+
+    char line[512];
+    for (size_t i = 0; i < measurements.size(); ++i) {
+        const Measurement& m = measurements[i];
+        out += i ? ",\n    {" : "\n    {";
+        out += "\"corpus\": ";
+        AppendJsonString(out, m.corpus);
+        out += ", \"mode\": ";
+        AppendJsonString(out, m.mode);
+        // Scans that produce no tokens (directives, UTF-8 checks) have no per-token cost.
+        if (m.perToken && m.tokens) {
+            snprintf(line, sizeof(line),
+                ", \"bytes\": %zu, \"tokens\": %zu, \"seconds\": %.6f, \"mb_per_s\": %.2f, \"tokens_per_s\": %.0f, \"ns_per_token\": %.2f}",
+                m.bytes, m.tokens, m.seconds, m.bytes / m.seconds / 1e6, m.tokens / m.seconds, m.seconds * 1e9 / m.tokens);
+        }
+        else {
+            snprintf(line, sizeof(line),
+                ", \"bytes\": %zu, \"tokens\": %s, \"seconds\": %.6f, \"mb_per_s\": %.2f, \"tokens_per_s\": null, \"ns_per_token\": null}",
+                m.bytes, m.perToken ? "0" : "null", m.seconds, m.bytes / m.seconds / 1e6);
+        }
+        out += line;
+    }
+
+    out += measurements.empty() ? "]" : "\n  ]";
+}
+
+static void PrintTable(const char* title, const vector<Measurement>& measurements) {
+    fprintf(stderr, "%s\n%-22s %-30s %10s %12s %10s\n", title, "corpus", "mode", "MB/s", "tokens/s", "ns/token");
+    for (const Measurement& m : measurements) {
+        if (m.perToken && m.tokens) {
+            fprintf(stderr, "%-22s %-30s %10.1f %12.0f %10.2f\n", m.corpus.c_str(), m.mode.c_str(),
+                m.bytes / m.seconds / 1e6, m.tokens / m.seconds, m.seconds * 1e9 / m.tokens);
+        }
+        else {
+            fprintf(stderr, "%-22s %-30s %10.1f %12s %10s\n", m.corpus.c_str(), m.mode.c_str(), m.bytes / m.seconds / 1e6, "-", "-");
+        }
+    }
+}
+
+int main(int argc, char** argv) {
+    BenchOptions bench;
+
+    for (int i = 1; i < argc; ++i) {
+        string arg = argv[i];
+        size_t mb = 0;
+        if (arg.rfind("--size=", 0) == 0 && ParseCount(string_view(arg).substr(7), mb) && mb > 0) bench.bytes = mb << 20;
+        else if (arg.rfind("--repeat=", 0) == 0 && ParseCount(string_view(arg).substr(9), bench.repeats) && bench.repeats > 0) {}
+        else if (arg.rfind("--jobs=", 0) == 0 && ParseCount(string_view(arg).substr(7), bench.jobs)) {}
+        else if (arg.rfind("--sample=", 0) == 0) bench.sample = arg.substr(9);
+        else if (arg.rfind("--out=", 0) == 0) bench.out = arg.substr(6);
+        else if (arg == "--regex") bench.regex = true;
+        else if (arg == "--scaling") bench.scaling = true;
+        else { PrintUsage(argv[0]); return 1; }
+    }
+
+    ifstream sampleFile(bench.sample, ios::binary);
+    if (!sampleFile) {
+        cerr << "Cannot open: " << bench.sample << "\n";
+        return 1;
+    }
+    stringstream sample;
+    sample << sampleFile.rdbuf();
+
+    vector<Corpus> corpora{
+        { "identifiers", MakeIdentifierHeavy(bench.bytes, 1) },
+        { "comments", MakeCommentHeavy(bench.bytes, 2) },
+        { "literals", MakeLiteralHeavy(bench.bytes, 3) },
+        { "web_server_mix", MakeScaledMix(sample.str(), bench.bytes) },
+    };
+
+    vector<Measurement> results, kinds, scaling;
+    for (const Corpus& corpus : corpora) MeasureCorpus(corpus, bench, results);
+    MeasureKinds(corpora.back().text, bench.repeats, kinds);
+    if (bench.scaling) MeasureScaling(corpora.back(), bench, scaling);
+
+    PrintTable("throughput", results);
+    PrintTable("per token kind (web_server_mix)", kinds);
+    if (bench.scaling) PrintTable("parallel scaling", scaling);
+
+    char header[256];
+    snprintf(header, sizeof(header), "{\n  \"corpus_bytes\": %zu,\n  \"repeats\": %zu,\n  \"threads\": %zu,\n  \"peak_rss_bytes\": %zu,\n",
+        bench.bytes, bench.repeats, clex::ThreadPool::DefaultSize(), PeakRssBytes());
+
+    string json = header;
+    AppendMeasurements(json, "results", results);
+    json += ",\n";
+    AppendMeasurements(json, "kinds", kinds);
+    json += ",\n";
+    AppendMeasurements(json, "scaling", scaling);
+    json += "\n}\n";
+
+    if (bench.out.empty()) {
+        fwrite(json.data(), 1, json.size(), stdout);
+        return 0;
+    }
+
+    ofstream out(bench.out, ios::binary);
+    if (!out.write(json.data(), static_cast<streamsize>(json.size()))) {
+        cerr << "Cannot write: " << bench.out << "\n";
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,97 @@
+#include <cerrno>
+#include <csignal>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <iostream>
+#include <string>
+#include <vector>
+#include <sys/wait.h>
+#include <unistd.h>
+#include "lexer/LexServer.hpp"
+using namespace std;
+
+// clexc: takes clexer's arguments and has a `clexer --serve` answer them, so a
+// script switches by renaming the command. When no server is listening, or the
+// request is a mode the server leaves alone, it runs clexer itself.
+
+static string ReadStdin() {
+    string input;
+    char chunk[64 * 1024];
+    size_t n;
+    while ((n = fread(chunk, 1, sizeof chunk, stdin)) > 0) input.append(chunk, n);
+    return input;
+}
+
+// $CLEXER, else the clexer next to this binary, else clexer on the PATH.
+static string LocalLexer(const char* argv0) {
+    if (const char* env = getenv("CLEXER"); env && *env) return env;
+    const string self = argv0;
+    const size_t slash = self.rfind('/');
+    if (slash != string::npos) {
+        const string sibling = self.substr(0, slash + 1) + "clexer";
+        if (access(sibling.c_str(), X_OK) == 0) return sibling;
+    }
+    return "clexer";
+}
+
+// Runs clexer with our arguments; stdin has already been read into `input`
+// when one of them is "-", so it is piped through.
+static int RunLocally(int argc, char** argv, bool hasInput, const string& input) {
+    const string lexer = LocalLexer(argv[0]);
+    vector<char*> args { const_cast<char*>(lexer.c_str()) };
+    args.insert(args.end(), argv + 1, argv + argc);
+    args.push_back(nullptr);
+
+    if (!hasInput) {
+        execvp(args[0], args.data());
+        cerr << "clexc: cannot run " << lexer << "\n";
+        return 1;
+    }
+
+    int fds[2];
+    if (pipe(fds) != 0) { perror("clexc"); return 1; }
+    pid_t child = fork();
+    if (child < 0) { perror("clexc"); return 1; }
+    if (child == 0) {
+        dup2(fds[0], STDIN_FILENO);
+        close(fds[0]);
+        close(fds[1]);
+        execvp(args[0], args.data());
+        _exit(127);
+    }
+
+    close(fds[0]);
+    signal(SIGPIPE, SIG_IGN);
+    for (size_t written = 0; written < input.size(); ) {
+        ssize_t n = write(fds[1], input.data() + written, input.size() - written);
+        if (n <= 0) break;
+        written += static_cast<size_t>(n);
+    }
+    close(fds[1]);
+
+    int status = 0;
+    while (waitpid(child, &status, 0) < 0 && errno == EINTR) {}
+    return WIFEXITED(status) ? WEXITSTATUS(status) : 1;
+}
+
+int main(int argc, char** argv) {
+    clex::LexRequest request;
+    request.args.assign(argv + 1, argv + argc);
+    for (const string& arg : request.args) request.hasInput = request.hasInput || arg == "-";
+    if (request.hasInput) request.input = ReadStdin();
+
+    error_code ec;
+    request.directory = filesystem::current_path(ec).string();
+
+    clex::LexResponse response;
+    string error;
+    if (!clex::CallServer(clex::DefaultSocketPath(), request, response, error) || response.exitCode == clex::LexResponse::kRunLocally) {
+        return RunLocally(argc, argv, request.hasInput, request.input);
+    }
+
+    fwrite(response.out.data(), 1, response.out.size(), stdout);
+    fflush(stdout);
+    fwrite(response.err.data(), 1, response.err.size(), stderr);
+    return response.exitCode;
+}
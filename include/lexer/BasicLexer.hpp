@@ -0,0 +1,124 @@
+#pragma once
+#include <array>
+#include <memory>
+#include <string_view>
+#include <vector>
+#include "Lexer.hpp"
+#include "LineIndex.hpp"
+#include "Token.hpp"
+#include "Utf8.hpp"
+#include "detail/Scan.hpp"
+using namespace std;
+
+namespace clex {
+
+    // Compile-time switches for BasicLexer. Derive from one of the policies below
+    // and override the members to change; every switch is tested with
+    // `if constexpr`, so turned-off work is not in the instantiated code.
+    struct DefaultPolicy {
+        static constexpr bool kComments = true;           // emit Comment tokens, else skip them like whitespace
+        static constexpr bool kPreprocessor = true;       // emit Preprocessor tokens, else skip them
+        static constexpr bool kPositions = true;          // track line/column; else tokens carry {0, 0}, Errors excepted
+        static constexpr bool kCodePointColumns = false;  // count columns in UTF-8 code points rather than bytes
+        static constexpr bool kLexemes = true;            // copy the lexeme into Token::lexeme
+        static constexpr bool kMessages = true;           // copy Error messages into Token::message
+    };
+
+    // Byte offsets only; the dispatch engine of an untracked Lexer.
+    struct OffsetsPolicy : DefaultPolicy {
+        static constexpr bool kPositions = false;
+    };
+
+    // Columns in code points; the dispatch engine of a Lexer with codePointColumns.
+    struct CodePointPolicy : DefaultPolicy {
+        static constexpr bool kCodePointColumns = true;
+    };
+
+    // What CountKinds() needs: token kinds and nothing else.
+    struct CountingPolicy : DefaultPolicy {
+        static constexpr bool kPositions = false;
+        static constexpr bool kLexemes = false;
+        static constexpr bool kMessages = false;
+    };
+
+    using TokenHistogram = array<size_t, kTokenKindCount>;
+
+    // Dispatch-engine lexer specialized by Policy. With DefaultPolicy it yields
+    // the same tokens as Lexer; Lexer adds the runtime options, the regex engine
+    // and the compact, parallel and incremental entry points on top of the same
+    // scan core. The viewed source must outlive the lexer.
+    template <class Policy = DefaultPolicy>
+    class BasicLexer {
+    public:
+        explicit BasicLexer(string_view source, CStandard standard = CStandard::C11)
+            : source_(source), standard_(standard), index_(Utf8BomLength(source)) {}
+
+        Token GetNextToken() {
+            detail::RawToken raw;
+            if (!Next(raw)) return Token{ TokenKind::EndOfFile, {}, CursorPos(), {} };
+
+            Token t;
+            t.kind = raw.kind;
+            t.pos = raw.pos;
+            if constexpr (Policy::kLexemes) t.lexeme.assign(source_.data() + raw.offset, raw.length);
+            if constexpr (Policy::kMessages) {
+                if (raw.message) t.message = raw.message;
+            }
+            return t;
+        }
+
+        // Like Lexer::TokenizeAll: stops after the first Error, else ends with EndOfFile.
+        vector<Token> TokenizeAll() {
+            vector<Token> out;
+            out.reserve(Lexer::EstimateTokenCount(source_.size() - index_));
+
+            while (true) {
+                out.push_back(GetNextToken());
+                if (out.back().kind == TokenKind::EndOfFile || out.back().kind == TokenKind::Error) break;
+            }
+            return out;
+        }
+
+        // Counts the remaining tokens by kind without building any. Scanning
+        // resumes after Error tokens; EndOfFile is not counted.
+        TokenHistogram CountKinds() {
+            TokenHistogram counts{};
+            detail::RawToken raw;
+            while (detail::ScanToken<Policy>(source_, standard_, index_, line_, column_, raw)) {
+                ++counts[static_cast<size_t>(raw.kind)];
+            }
+            return counts;
+        }
+
+        bool IsEndOfInput() const { return index_ >= source_.size(); }
+        size_t Offset() const { return index_; }
+        string_view Source() const { return source_; }
+
+    private:
+        // Errors always get a position, even when nothing else is tracked.
+        bool Next(detail::RawToken& out) {
+            if (!detail::ScanToken<Policy>(source_, standard_, index_, line_, column_, out)) return false;
+            if constexpr (!Policy::kPositions) {
+                if (out.kind == TokenKind::Error) {
+                    if (!lines_) lines_ = make_unique<LineIndex>(source_);
+                    out.pos = Policy::kCodePointColumns ? lines_->CodePointPositionOf(source_, out.offset) : lines_->PositionOf(out.offset);
+                }
+            }
+            return true;
+        }
+
+        SourcePos CursorPos() const {
+            return Policy::kPositions ? SourcePos{ line_, column_ } : SourcePos{ 0, 0 };
+        }
+
+    private:
+        string_view source_;
+        CStandard   standard_;
+        size_t      index_ = 0;
+        int         line_ = 1;
+        int         column_ = 1;
+
+        unique_ptr<LineIndex> lines_;
+    };
+
+}
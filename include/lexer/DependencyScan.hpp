@@ -0,0 +1,46 @@
+#pragma once
+#include <cstdint>
+#include <string_view>
+#include <vector>
+using namespace std;
+
+namespace clex {
+
+    enum class DirectiveKind : uint8_t {
+        Include, IncludeNext, Import, Define, Undef,
+        If, Ifdef, Ifndef, Elif, Elifdef, Elifndef, Else, Endif,
+        Pragma, Other
+    };
+
+    // How an #include names its header: "path", <path>, or a macro to expand.
+    enum class IncludeForm : uint8_t { None, Quoted, Angled, Macro };
+
+    string_view DirectiveName(DirectiveKind kind);
+
+    // One directive; the views point into the scanned source.
+    struct Directive {
+        DirectiveKind kind = DirectiveKind::Other;
+        IncludeForm   form = IncludeForm::None;
+        uint32_t      line = 0;      // line of the '#'
+        uint32_t      offset = 0;    // byte offset of the '#'
+        string_view   name;          // directive word as written, empty for a null directive
+        // Header path without its delimiters, macro name for define/undef/ifdef
+        // and friends, or the rest of the logical line (trimmed, continuations
+        // kept) for everything else.
+        string_view   argument;
+    };
+
+    struct DependencyRecord {
+        vector<Directive> directives;
+        string_view       guard;     // include-guard macro when the whole file is guarded
+
+        size_t IncludeCount() const;
+    };
+
+    // Finds the directives of `source` without lexing it: code lines are skipped
+    // byte-wise, stepping only over comments, string and char literals and
+    // backslash continuations, so a '#' counts only where it begins a logical
+    // line. Much cheaper than Lexer, which classifies every token.
+    DependencyRecord ScanDependencies(string_view source);
+
+}
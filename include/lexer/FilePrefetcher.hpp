@@ -0,0 +1,97 @@
+#pragma once
+#include <atomic>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+using namespace std;
+
+namespace clex {
+
+    // One file handed out by a FilePrefetcher. `data` stays valid until the file
+    // is released.
+    struct PrefetchedFile {
+        size_t      index = 0;          // position in the prefetcher's path list
+        string_view data;
+        string      error;              // set when the file could not be read
+        double      readSeconds = 0;    // from open to the last byte arriving
+        double      waitSeconds = 0;    // how long Next() blocked for it
+        size_t      slot = 0;
+    };
+
+    // Reads a list of files ahead of the threads that consume them, so lexing
+    // one file overlaps reading the next ones. At most `depth` files are held at
+    // once, each in a buffer that is reused for a later file once released, so
+    // memory stays bounded by the largest `depth` files.
+    //
+    // On Linux the reads go through an io_uring with `depth` entries when the
+    // kernel allows it; otherwise, or if the ring fails later on, a few reader
+    // threads pread() ahead. Opening and sizing a file is always synchronous on
+    // the I/O side.
+    class FilePrefetcher {
+    public:
+        enum class Backend { Auto, IoUring, Threads };
+
+        FilePrefetcher(vector<string> paths, size_t depth, Backend backend = Backend::Auto);
+        ~FilePrefetcher();
+
+        FilePrefetcher(const FilePrefetcher&) = delete;
+        FilePrefetcher& operator=(const FilePrefetcher&) = delete;
+
+        // Hands out the next file in path order, waiting until it has been read.
+        // Safe to call from several threads; false once every file is taken.
+        bool Next(PrefetchedFile& out);
+
+        // Returns the file's buffer for reuse; `file.data` is invalid afterwards.
+        void Release(const PrefetchedFile& file);
+
+        // "io_uring" or "threads": what Auto resolved to, or "threads" once a
+        // failing ring has handed its work to reader threads.
+        const char* BackendName() const;
+        size_t Depth() const { return slots_.size(); }
+
+    private:
+        struct Slot {
+            string buffer;
+            bool   free = true;
+        };
+
+        struct Loaded {
+            bool   ready = false;
+            size_t slot = 0;
+            size_t size = 0;
+            string error;
+            double readSeconds = 0;
+        };
+
+        struct Ring;
+
+        // Takes a free slot for the next unread path, waiting for one to be
+        // released when `wait`; false when stopping or nothing is left.
+        bool Claim(size_t& index, size_t& slot, bool wait);
+        void Publish(size_t index, size_t slot, size_t size, string error, double readSeconds);
+
+        void RunThreads();
+        void RunRing();
+
+    private:
+        vector<string> paths_;
+        vector<Slot>   slots_;
+        vector<Loaded> loaded_;
+
+        mutex              lock_;
+        condition_variable slotFreed_;
+        condition_variable fileReady_;
+        size_t             nextRead_ = 0;
+        size_t             nextHandOut_ = 0;
+        bool               stopping_ = false;
+
+        unique_ptr<Ring> ring_;
+        atomic<bool>     ringFailed_{ false };   // the ring stopped working; pread readers took over
+        vector<thread>   readers_;
+    };
+
+}
@@ -0,0 +1,18 @@
+#pragma once
+#include <string>
+#include <string_view>
+#include <vector>
+using namespace std;
+
+namespace clex {
+
+    // Expands command-line inputs into a deterministic list of files:
+    //   dir/          every .c/.h file below it, sorted
+    //   src/**/*.c    glob; '*' and '?' stay within one path segment, '**' spans any
+    //   @list.txt     response file with one input per line ('#' starts a comment)
+    //   anything else is taken as a plain path.
+    vector<string> ExpandInputs(const vector<string>& inputs, string& error);
+
+    bool MatchGlob(string_view pattern, string_view path);
+
+}
@@ -0,0 +1,11 @@
+#pragma once
+#include <cstdint>
+#include <string_view>
+using namespace std;
+
+namespace clex {
+
+    // XXH64 of `bytes`: fast, non-cryptographic, stable across runs and platforms.
+    uint64_t HashBytes(string_view bytes, uint64_t seed = 0);
+
+}
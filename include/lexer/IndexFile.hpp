@@ -0,0 +1,136 @@
+#pragma once
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+#include "MappedFile.hpp"
+using namespace std;
+
+namespace clex {
+
+    // Inverted index from identifier and keyword spellings to where they occur,
+    // in host byte order (little-endian on every supported target):
+    //
+    //   Header
+    //   FileRecord[fileCount]
+    //   TermRecord[termCount]             sorted by spelling, for binary search
+    //   postings                          postingBytes bytes of varints
+    //   strings                           stringBytes bytes: term spellings and paths
+    //
+    // A term's postings are runs, one per file in file order: varint file delta
+    // (from the previous run's file, or 0), varint count, then per occurrence the
+    // varint offset delta, line delta (both from the previous occurrence in the
+    // file, or 0) and column.
+    namespace indexfile {
+
+        constexpr char     kMagic[4] = { 'C', 'L', 'X', 'I' };
+        constexpr uint32_t kVersion = 2;    // 2: names on preprocessor lines are indexed
+
+        struct Header {
+            char     magic[4];
+            uint32_t version;
+            uint32_t lexerVersion;      // postings from another lexer are not reused
+            uint32_t reserved;
+            uint64_t fileCount;
+            uint64_t termCount;
+            uint64_t postingBytes;
+            uint64_t stringBytes;
+        };
+
+        // `modified` is the file's mtime in file_time_type ticks; with `size` it
+        // lets an update skip unchanged files without reading them.
+        struct FileRecord {
+            uint64_t hash;              // HashBytes of the contents
+            uint64_t size;
+            int64_t  modified;
+            uint32_t pathOffset;
+            uint32_t pathLength;
+        };
+
+        struct TermRecord {
+            uint64_t postingOffset;
+            uint32_t postingBytes;
+            uint32_t postingCount;
+            uint32_t nameOffset;
+            uint32_t nameLength;
+        };
+
+        static_assert(sizeof(Header) == 48, "indexfile::Header must stay 48 bytes");
+        static_assert(sizeof(FileRecord) == 32, "indexfile::FileRecord must stay 32 bytes");
+        static_assert(sizeof(TermRecord) == 24, "indexfile::TermRecord must stay 24 bytes");
+
+    }
+
+    struct IndexPosting {
+        uint32_t file = 0;              // index into the IndexFile's file list
+        uint32_t offset = 0;
+        uint32_t line = 0;
+        uint32_t column = 0;
+    };
+
+    // Read-only access to a mapped index. Lookups binary-search the term table
+    // and decode one posting list; nothing else is touched.
+    class IndexFile {
+    public:
+        bool Open(const string& path);
+
+        // Validates an index already in memory; `bytes` must outlive this object.
+        bool Load(string_view bytes);
+
+        uint32_t LexerVersion() const { return header_.lexerVersion; }
+
+        size_t FileCount() const { return static_cast<size_t>(header_.fileCount); }
+        indexfile::FileRecord File(size_t index) const;
+        string_view FilePath(size_t index) const;
+
+        size_t TermCount() const { return static_cast<size_t>(header_.termCount); }
+        string_view Term(size_t index) const;
+        size_t PostingCount(size_t term) const;
+
+        // Position of `term` in the sorted term table, TermCount() if absent.
+        size_t FindTerm(string_view term) const;
+
+        // First term not ordered before `prefix`; with FindTerm's order, every
+        // term starting with `prefix` follows it.
+        size_t LowerBound(string_view prefix) const;
+
+        // Appends the postings of term `index` in file and offset order; false
+        // if the list is corrupt.
+        bool Postings(size_t term, vector<IndexPosting>& out) const;
+
+        const string& Error() const { return error_; }
+
+    private:
+        bool Fail(string message);
+        indexfile::TermRecord TermAt(size_t index) const;
+        string_view String(uint32_t offset, uint32_t length) const;
+
+    private:
+        MappedFile                    file_;
+        indexfile::Header             header_{};
+        const indexfile::FileRecord*  files_ = nullptr;
+        const indexfile::TermRecord*  terms_ = nullptr;
+        string_view                   postings_;
+        string_view                   strings_;
+        string                        error_;
+    };
+
+    struct IndexUpdate {
+        size_t         lexed = 0;       // new or changed files
+        size_t         reused = 0;      // unchanged files whose postings were kept
+        size_t         removed = 0;     // files of the old index no longer listed
+        size_t         terms = 0;
+        size_t         postings = 0;
+        vector<string> unreadable;      // left out of the index
+    };
+
+    // Indexes every Identifier and Keyword of `files` into `indexPath`, including
+    // the directive names and the names inside preprocessor lines. When an
+    // index is already there, files with the same size and mtime, or failing
+    // that the same contents, keep their postings without being lexed again,
+    // and files not listed any more drop out. Lexing recovers from errors, so a
+    // bad byte does not hide the rest of a file. The new index is written next
+    // to the old one and renamed over it.
+    bool UpdateIndex(const string& indexPath, const vector<string>& files, size_t jobs, IndexUpdate& update, string& error);
+
+}
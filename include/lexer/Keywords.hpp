@@ -0,0 +1,123 @@
+#pragma once
+#include <array>
+#include <cstdint>
+#include <string_view>
+using namespace std;
+
+namespace clex {
+
+    enum class CStandard : uint8_t { C89, C99, C11, C23 };
+
+    namespace keywords {
+
+        struct Entry {
+            string_view spelling;
+            CStandard   since;
+        };
+
+        // One row per keyword, tagged with the standard that introduced it. Adding
+        // a row is all it takes; the hash below is regenerated at compile time.
+        inline constexpr Entry kTable[] = {
+            { "auto", CStandard::C89 },     { "break", CStandard::C89 },    { "case", CStandard::C89 },
+            { "char", CStandard::C89 },     { "const", CStandard::C89 },    { "continue", CStandard::C89 },
+            { "default", CStandard::C89 },  { "do", CStandard::C89 },       { "double", CStandard::C89 },
+            { "else", CStandard::C89 },     { "enum", CStandard::C89 },     { "extern", CStandard::C89 },
+            { "float", CStandard::C89 },    { "for", CStandard::C89 },      { "goto", CStandard::C89 },
+            { "if", CStandard::C89 },       { "int", CStandard::C89 },      { "long", CStandard::C89 },
+            { "register", CStandard::C89 }, { "return", CStandard::C89 },   { "short", CStandard::C89 },
+            { "signed", CStandard::C89 },   { "sizeof", CStandard::C89 },   { "static", CStandard::C89 },
+            { "struct", CStandard::C89 },   { "switch", CStandard::C89 },   { "typedef", CStandard::C89 },
+            { "union", CStandard::C89 },    { "unsigned", CStandard::C89 }, { "void", CStandard::C89 },
+            { "volatile", CStandard::C89 }, { "while", CStandard::C89 },
+
+            { "inline", CStandard::C99 },   { "restrict", CStandard::C99 }, { "_Bool", CStandard::C99 },
+            { "_Complex", CStandard::C99 }, { "_Imaginary", CStandard::C99 },
+
+            { "_Alignas", CStandard::C11 },  { "_Alignof", CStandard::C11 },       { "_Atomic", CStandard::C11 },
+            { "_Generic", CStandard::C11 },  { "_Noreturn", CStandard::C11 },      { "_Static_assert", CStandard::C11 },
+            { "_Thread_local", CStandard::C11 },
+
+            { "alignas", CStandard::C23 },   { "alignof", CStandard::C23 },        { "bool", CStandard::C23 },
+            { "constexpr", CStandard::C23 }, { "false", CStandard::C23 },          { "nullptr", CStandard::C23 },
+            { "static_assert", CStandard::C23 }, { "thread_local", CStandard::C23 }, { "true", CStandard::C23 },
+            { "typeof", CStandard::C23 },    { "typeof_unqual", CStandard::C23 },  { "_BitInt", CStandard::C23 },
+            { "_Decimal32", CStandard::C23 }, { "_Decimal64", CStandard::C23 },    { "_Decimal128", CStandard::C23 },
+        };
+
+        inline constexpr size_t kCount = sizeof(kTable) / sizeof(kTable[0]);
+        inline constexpr uint32_t kSlotCount = 512;
+        inline constexpr uint8_t kEmpty = 0xFF;
+
+        constexpr size_t MinLength() {
+            size_t n = kTable[0].spelling.size();
+            for (const Entry& e : kTable) n = e.spelling.size() < n ? e.spelling.size() : n;
+            return n;
+        }
+
+        constexpr size_t MaxLength() {
+            size_t n = 0;
+            for (const Entry& e : kTable) n = e.spelling.size() > n ? e.spelling.size() : n;
+            return n;
+        }
+
+        inline constexpr size_t kMinLength = MinLength();
+        inline constexpr size_t kMaxLength = MaxLength();
+
+        // Only looks at the length and three bytes, so it needs s.size() >= 2.
+        constexpr uint32_t Hash(string_view s, uint32_t seed) {
+            uint32_t h = seed ^ static_cast<uint32_t>(s.size());
+            h = (h ^ static_cast<unsigned char>(s[0])) * 0x9E3779B1u;
+            h = (h ^ static_cast<unsigned char>(s[1])) * 0x85EBCA77u;
+            h = (h ^ static_cast<unsigned char>(s[s.size() - 1])) * 0xC2B2AE3Du;
+            return (h ^ (h >> 16)) & (kSlotCount - 1);
+        }
+
+        constexpr bool IsCollisionFree(uint32_t seed) {
+            bool used[kSlotCount] = {};
+            for (const Entry& e : kTable) {
+                uint32_t slot = Hash(e.spelling, seed);
+                if (used[slot]) return false;
+                used[slot] = true;
+            }
+            return true;
+        }
+
+        constexpr uint32_t FindSeed() {
+            for (uint32_t seed = 1; seed < 10000; ++seed) {
+                if (IsCollisionFree(seed)) return seed;
+            }
+            return 0;
+        }
+
+        inline constexpr uint32_t kSeed = FindSeed();
+        static_assert(kSeed != 0, "no perfect hash seed for the keyword table");
+        static_assert(kCount < kEmpty, "keyword indices must fit in a byte");
+
+        constexpr array<uint8_t, kSlotCount> BuildSlots() {
+            array<uint8_t, kSlotCount> slots{};
+            for (uint8_t& s : slots) s = kEmpty;
+            for (size_t i = 0; i < kCount; ++i) slots[Hash(kTable[i].spelling, kSeed)] = static_cast<uint8_t>(i);
+            return slots;
+        }
+
+        inline constexpr array<uint8_t, kSlotCount> kSlots = BuildSlots();
+
+    }
+
+    constexpr bool IsKeyword(string_view s, CStandard standard) {
+        if (s.size() < keywords::kMinLength || s.size() > keywords::kMaxLength) return false;
+
+        uint8_t index = keywords::kSlots[keywords::Hash(s, keywords::kSeed)];
+        if (index == keywords::kEmpty) return false;
+
+        const keywords::Entry& e = keywords::kTable[index];
+        return e.since <= standard && e.spelling == s;
+    }
+
+    template <CStandard Standard>
+    constexpr bool IsKeyword(string_view s) { return IsKeyword(s, Standard); }
+
+    static_assert(IsKeyword<CStandard::C89>("while") && !IsKeyword<CStandard::C89>("inline"));
+    static_assert(IsKeyword<CStandard::C11>("_Atomic") && !IsKeyword<CStandard::C11>("bool"));
+
+}
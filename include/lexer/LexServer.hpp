@@ -0,0 +1,78 @@
+#pragma once
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <vector>
+using namespace std;
+
+namespace clex {
+
+    // One call to a serving clexer: its command-line arguments, the directory
+    // relative paths are resolved against, and stdin when an argument is "-".
+    struct LexRequest {
+        string         directory;
+        vector<string> args;
+        bool           hasInput = false;
+        string         input;
+    };
+
+    // What the call would have printed and its exit code. kRunLocally tells the
+    // client to run clexer itself, for modes the server does not handle.
+    struct LexResponse {
+        static constexpr int kRunLocally = -1;
+
+        int    exitCode = 0;
+        string out;
+        string err;
+    };
+
+    // $CLEX_SOCKET, else clexer.sock in $XDG_RUNTIME_DIR, else /tmp/clexer-<uid>.sock.
+    string DefaultSocketPath();
+
+    // Accepts requests on a Unix domain socket and answers them on a thread
+    // pool, one request per connection. Requests and responses are length-
+    // prefixed frames in host byte order, since both ends share a machine.
+    class LexServer {
+    public:
+        using Handler = function<void(const LexRequest& request, LexResponse& response)>;
+
+        // Largest request, counting the directory, arguments and input; a larger
+        // one is dropped before its bytes are buffered.
+        static constexpr uint64_t kMaxRequestBytes = uint64_t(256) << 20;
+
+        LexServer(string socketPath, Handler handler, size_t threads = 0);
+        ~LexServer();
+
+        LexServer(const LexServer&) = delete;
+        LexServer& operator=(const LexServer&) = delete;
+
+        // Binds the socket and serves until Stop(), then removes it. False with
+        // `error` when it cannot listen, e.g. another server owns the path; a
+        // stale socket left by a crashed server is replaced.
+        bool Run(string& error);
+
+        // Makes Run() return once the requests in progress are answered. Safe to
+        // call from a signal handler.
+        void Stop();
+
+        uint64_t Served() const { return served_.load(memory_order_relaxed); }
+
+    private:
+        void Serve(int connection);
+
+    private:
+        string           socketPath_;
+        Handler          handler_;
+        size_t           threads_;
+        int              wakeRead_ = -1;
+        int              wakeWrite_ = -1;
+        atomic<uint64_t> served_{ 0 };
+    };
+
+    // Sends `request` to the server at `socketPath` and waits for the answer.
+    // False with `error` when no server is listening, the connection drops or
+    // the request is over LexServer::kMaxRequestBytes.
+    bool CallServer(const string& socketPath, const LexRequest& request, LexResponse& response, string& error);
+
+}
@@ -2,21 +2,160 @@
 #include <string>
 #include <vector>
 #include <string_view>
+#include <memory>
+#include "Keywords.hpp"
+#include "LexerStats.hpp"
+#include "LineIndex.hpp"
 #include "Token.hpp"
+#include "detail/Scan.hpp"
 using namespace std;
 
 namespace clex {
 
+    // Dispatch branches on the first byte of every token; Regex is the original
+    // std::regex cascade, kept so both engines can be compared side by side.
+    enum class ScanEngine { Dispatch, Regex };
+
+    // Replacement of `removedLength` bytes at `offset` by `insertedLength` new bytes.
+    struct TextEdit {
+        size_t offset = 0;
+        size_t removedLength = 0;
+        size_t insertedLength = 0;
+    };
+
+    // Bumped whenever some input lexes to different tokens, so streams cached by
+    // an older build are never reused.
+    constexpr uint32_t kLexerVersion = 2;
+
+    class SymbolTable;
+
+    struct LexerOptions {
+        ScanEngine engine = ScanEngine::Dispatch;
+        CStandard  standard = CStandard::C11;
+
+        // When false the lexer only tracks byte offsets: tokens carry line and
+        // column 0, except Error tokens, whose positions come from Lines().
+        bool       trackPositions = true;
+
+        // Columns count UTF-8 code points (every byte but continuation bytes)
+        // instead of bytes, for editors that index lines by character.
+        bool       codePointColumns = false;
+
+        // When set, every Identifier is interned here and its ID recorded in
+        // Token::symbol or CompactTokenStream::symbols. One table can serve many
+        // lexers at once; it must outlive them.
+        SymbolTable* symbols = nullptr;
+
+        // By default lexing ends at the first Error token. When recovering, it
+        // resumes right after each one (after the rest of the line for an
+        // unterminated string or char, after the whole run for unknown bytes)
+        // and ends at EOF or at the maxErrors-th error; 0 means no cap. Every
+        // error is listed in CompactTokenStream::diagnostics.
+        bool       recoverFromErrors = false;
+        size_t     maxErrors = 0;
+
+        // Whether lexing ends at the `errors`-th Error token.
+        bool StopAfter(size_t errors) const { return !recoverFromErrors || (maxErrors != 0 && errors >= maxErrors); }
+    };
+
+    class MappedFile;
+    class ThreadPool;
+    class TokenRange;
+
     class Lexer {
     public:
-        explicit Lexer(string sourceText);
+        explicit Lexer(string sourceText, LexerOptions options = {});
+        explicit Lexer(const char* sourceText, LexerOptions options = {});
+
+        // Non-owning: the viewed bytes (or the mapped file) must outlive the lexer
+        // and every CompactTokenStream it produces.
+        explicit Lexer(string_view sourceView, LexerOptions options = {});
+        explicit Lexer(const MappedFile& file, LexerOptions options = {});
 
         vector<Token> TokenizeAll();
+
+        // Same tokens, with the vector, lexemes and messages all allocated from
+        // `resource`; a monotonic_buffer_resource frees them in one shot.
+        pmr::vector<PmrToken> TokenizeAll(pmr::memory_resource* resource);
+
+        // Rough token count for `bytes` of C, used to size the output up front.
+        static size_t EstimateTokenCount(size_t bytes);
+
         Token GetNextToken();
         bool IsEndOfInput() const;
 
+        // Pulls TokenizeAll's stream in batches: fills out[0, n) with the next
+        // n <= capacity tokens and returns n, or 0 once EndOfFile (or the error
+        // that ends lexing) has been delivered. Strings already held by `out`
+        // are reused, so a buffer refilled call after call stops allocating.
+        size_t NextBatch(Token* out, size_t capacity);
+
+        // Same, into `batch` (cleared first): lexemes view Source(), and
+        // diagnostics and symbols are indexed within the batch.
+        size_t NextBatch(CompactTokenStream& batch, size_t capacity);
+
+        // Lazy, single-pass view of the same stream for range-for loops and
+        // filters; see TokenRange.hpp. The lexer must outlive the range.
+        TokenRange Tokens();
+
+        // Same stream as TokenizeAll, but lexemes are views into Source(), so the
+        // lexer must outlive the result.
+        CompactTokenStream TokenizeAllCompact();
+        string_view Source() const { return source_; }
+
+        // Line-start index of Source(), built on first use.
+        const LineIndex& Lines() const;
+
+        // Splits the source at newlines and lexes the chunks concurrently; the
+        // result is identical to TokenizeAllCompact(). threads == 0 uses every core.
+        CompactTokenStream TokenizeAllParallel(size_t threads = 0);
+        CompactTokenStream TokenizeAllParallel(ThreadPool& pool);
+
+        // Updates `stream`, produced for the text before `edit`, so that it matches
+        // this lexer's source (the text after the edit). Only the tokens between the
+        // nearest safe restart point and the first token that lines up with the old
+        // stream again are re-lexed; the rest are shifted.
+        void Relex(CompactTokenStream& stream, const TextEdit& edit);
+
+        // Resumes scanning at `offset`, which must be a token start or lie in
+        // whitespace between tokens; `pos` is the position of that byte.
+        void Seek(size_t offset, SourcePos pos);
+        size_t Offset() const { return index_; }
+        SourcePos Position() const { return { line_, column_ }; }
+
+        // Per-rule counters for everything this lexer scanned, helpers of
+        // TokenizeAllParallel included. Zero unless built with CLEX_STATS.
+        const LexerStats& Stats() const;
+
     private:
+        friend class StreamLexer;
+
+        using RawToken = detail::RawToken;
+
+        bool  ScanWithRegex(RawToken& out);
+        bool  ScanWithDispatch(RawToken& out);
+        bool  ScanRawToken(RawToken& out);
+        void  ExtendUnknownRun(RawToken& error);
+        void  FinishError(RawToken& error);
+        template <class Emit> size_t FillBatch(size_t capacity, Emit&& emit);
+        template <class Policy, class Emit> size_t ScanBatch(size_t capacity, Emit&& emit);
+        bool  NextRawToken(RawToken& out);
+        void  TokenizeChunk(size_t end, CompactTokenStream& out);
+        bool  RejectOversized(CompactTokenStream& out) const;
+        void  SettleErrorCap(CompactTokenStream& stream, vector<TokenDiagnostic>& diagnostics, bool symbolsSpliced);
+        void  FinishRelex(CompactTokenStream& stream, vector<TokenDiagnostic> diagnostics, bool symbolsSpliced);
+
+#ifdef CLEX_STATS
+        LexerStats* StatsSink() { return &stats_; }
+        void  MergeStats(const Lexer& other) { stats_ += other.stats_; }
+#else
+        LexerStats* StatsSink() { return nullptr; }
+        void  MergeStats(const Lexer&) {}
+#endif
+
         void  AdvanceCursor(string_view matchedLexeme);
+        SourcePos CursorPos() const;
+        SourcePos ErrorPosition(size_t offset) const;
         Token MakeToken(TokenKind kind,
             string_view lexeme,
             int lineAtStart,
@@ -24,10 +163,19 @@ namespace clex {
             string message = {});
 
     private:
-        string     sourceText_;
-        size_t     index_ = 0;
-        int        line_ = 1;
-        int        column_ = 1;
+        shared_ptr<const string> ownedSource_;
+        string_view  source_;
+        LexerOptions options_;
+        size_t       index_ = 0;
+        int          line_ = 1;
+        int          column_ = 1;
+        bool         batchDone_ = false;
+        size_t       batchErrors_ = 0;
+
+        mutable shared_ptr<const LineIndex> lines_;
+#ifdef CLEX_STATS
+        LexerStats   stats_;
+#endif
     };
 
 }
\ No newline at end of file
@@ -0,0 +1,96 @@
+#pragma once
+#include <array>
+#include <cstdint>
+#include <string_view>
+#ifdef CLEX_STATS
+#include <chrono>
+#if defined(_MSC_VER)
+#include <intrin.h>
+#elif defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+#endif
+using namespace std;
+
+namespace clex {
+
+    // Instrumentation is compiled in only when the library is configured with
+    // -DCLEX_STATS=ON; otherwise every probe is an empty inline call and
+    // Lexer::Stats() stays zero.
+#ifdef CLEX_STATS
+    constexpr bool kStatsEnabled = true;
+#else
+    constexpr bool kStatsEnabled = false;
+#endif
+
+    // Scanning rules as the regex engine tries them. The dispatch engine picks
+    // one rule per token from its first byte, so its attempts are the tokens
+    // (or whitespace runs) that reached the rule.
+    enum class LexRule {
+        Whitespace, Preprocessor, LineComment, BlockComment, StringLiteral, CharLiteral,
+        HexInt, Float, DecInt, Identifier, KeywordLookup, Operator, Unknown
+    };
+
+    constexpr size_t kLexRuleCount = static_cast<size_t>(LexRule::Unknown) + 1;
+
+    string_view RuleName(LexRule rule);
+
+    struct RuleStats {
+        uint64_t attempts = 0;
+        uint64_t matches = 0;
+        uint64_t bytes = 0;        // consumed by matches
+        uint64_t cycles = 0;       // TSC ticks (steady_clock ticks off x86), misses included
+        uint64_t allocations = 0;  // operator new calls on the scanning thread
+    };
+
+    struct LexerStats {
+        array<RuleStats, kLexRuleCount> rules{};
+
+        RuleStats&       operator[](LexRule rule) { return rules[static_cast<size_t>(rule)]; }
+        const RuleStats& operator[](LexRule rule) const { return rules[static_cast<size_t>(rule)]; }
+
+        LexerStats& operator+=(const LexerStats& other);
+    };
+
+    // Heap allocations made so far on the calling thread; always 0 without CLEX_STATS.
+    uint64_t ThreadAllocations();
+
+    // Times one rule attempt from construction to Record(). A null `stats`
+    // records nothing.
+    class RuleProbe {
+    public:
+#ifdef CLEX_STATS
+        explicit RuleProbe(LexerStats* stats)
+            : stats_(stats), start_(stats ? Clock() : 0), allocations_(stats ? ThreadAllocations() : 0) {}
+
+        void Record(LexRule rule, bool matched, size_t bytes) {
+            if (!stats_) return;
+            RuleStats& r = (*stats_)[rule];
+            ++r.attempts;
+            if (matched) {
+                ++r.matches;
+                r.bytes += bytes;
+            }
+            r.cycles += Clock() - start_;
+            r.allocations += ThreadAllocations() - allocations_;
+        }
+
+    private:
+        static uint64_t Clock() {
+#if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__)
+            return __rdtsc();
+#else
+            return static_cast<uint64_t>(chrono::steady_clock::now().time_since_epoch().count());
+#endif
+        }
+
+        LexerStats* stats_;
+        uint64_t    start_;
+        uint64_t    allocations_;
+#else
+        explicit RuleProbe(LexerStats*) {}
+        void Record(LexRule, bool, size_t) {}
+#endif
+    };
+
+}
@@ -0,0 +1,36 @@
+#pragma once
+#include <cstdint>
+#include <string_view>
+#include <vector>
+#include "Token.hpp"
+using namespace std;
+
+namespace clex {
+
+    // Start offset of every line in a source, built with one vectorized newline
+    // scan. Positions are looked up on demand instead of being tracked byte by
+    // byte while lexing.
+    class LineIndex {
+    public:
+        LineIndex() = default;
+        explicit LineIndex(string_view source);
+
+        // 1-based line and byte column of `offset`; offsets past the end map to
+        // the position just after the last byte. A UTF-8 BOM is not part of line 1.
+        SourcePos PositionOf(size_t offset) const;
+
+        // Same, with the column counted in code points; `source` must be the
+        // text the index was built from.
+        SourcePos CodePointPositionOf(string_view source, size_t offset) const;
+
+        size_t LineCount() const { return starts_.size(); }
+        size_t LineStart(size_t line) const { return starts_[line - 1]; }
+
+        // Fills in line and column for every token of `stream` in one merge pass.
+        void Annotate(CompactTokenStream& stream) const;
+
+    private:
+        vector<size_t> starts_{ 0 };
+    };
+
+}
@@ -0,0 +1,41 @@
+#pragma once
+#include <string>
+#include <string_view>
+using namespace std;
+
+namespace clex {
+
+    // Read-only view of a whole file. Regular files are memory-mapped; pipes,
+    // character devices and "-" (stdin) fall back to read() into an owned buffer.
+    class MappedFile {
+    public:
+        MappedFile() = default;
+        ~MappedFile();
+
+        MappedFile(MappedFile&& other) noexcept;
+        MappedFile& operator=(MappedFile&& other) noexcept;
+        MappedFile(const MappedFile&) = delete;
+        MappedFile& operator=(const MappedFile&) = delete;
+
+        bool Open(const string& path);
+        void Close();
+
+        string_view View() const { return { data_, size_ }; }
+        bool IsMapped() const { return mapped_; }
+        const string& Error() const { return error_; }
+
+    private:
+        bool ReadAll(int fd);
+
+    private:
+        const char* data_ = nullptr;
+        size_t      size_ = 0;
+        bool        mapped_ = false;
+        string      buffer_;
+        string      error_;
+#ifdef _WIN32
+        void*       mapping_ = nullptr;
+#endif
+    };
+
+}
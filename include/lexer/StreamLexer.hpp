@@ -0,0 +1,78 @@
+#pragma once
+#include <functional>
+#include <istream>
+#include <string>
+#include "Lexer.hpp"
+#include "Token.hpp"
+using namespace std;
+
+namespace clex {
+
+    // Pull-based byte source. Read returns 0 only once the input is exhausted.
+    class ChunkSource {
+    public:
+        virtual ~ChunkSource() = default;
+        virtual size_t Read(char* dst, size_t capacity) = 0;
+    };
+
+    class IstreamSource : public ChunkSource {
+    public:
+        explicit IstreamSource(istream& in) : in_(in) {}
+        size_t Read(char* dst, size_t capacity) override;
+
+    private:
+        istream& in_;
+    };
+
+    class FdSource : public ChunkSource {
+    public:
+        explicit FdSource(int fd) : fd_(fd) {}
+        size_t Read(char* dst, size_t capacity) override;
+
+    private:
+        int fd_;
+    };
+
+    class CallbackSource : public ChunkSource {
+    public:
+        explicit CallbackSource(function<size_t(char*, size_t)> read) : read_(move(read)) {}
+        size_t Read(char* dst, size_t capacity) override { return read_(dst, capacity); }
+
+    private:
+        function<size_t(char*, size_t)> read_;
+    };
+
+    // Lexes input as it arrives. Only the bytes of the token being scanned (plus a
+    // little lookahead) and one read chunk are kept, so memory is bounded by the
+    // largest token rather than by the input size. Produces the same tokens as
+    // Lexer::GetNextToken over the whole input.
+    class StreamLexer {
+    public:
+        explicit StreamLexer(ChunkSource& source, LexerOptions options = {}, size_t chunkSize = 64 * 1024);
+
+        Token GetNextToken();
+        bool IsEndOfInput();
+
+        size_t BufferCapacity() const { return buffer_.size(); }
+
+        // Scanning counters, re-scans of tokens cut by a chunk boundary included.
+        const LexerStats& Stats() const { return stats_; }
+
+    private:
+        bool Fill(size_t minRead);
+        void SkipBom();
+
+    private:
+        ChunkSource& source_;
+        LexerOptions options_;
+        size_t       chunkSize_;
+        string       buffer_;
+        size_t       begin_ = 0;   // next unscanned byte in buffer_
+        size_t       size_ = 0;    // bytes of buffer_ holding input
+        SourcePos    pos_{};
+        bool         eof_ = false;
+        bool         started_ = false;   // a leading BOM has been looked for
+        LexerStats   stats_;
+    };
+
+}
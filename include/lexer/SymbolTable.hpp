@@ -0,0 +1,61 @@
+#pragma once
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string_view>
+#include <vector>
+#include "Token.hpp"
+using namespace std;
+
+namespace clex {
+
+    // Interned identifier spellings with dense 32-bit IDs (0, 1, 2, ... in the
+    // order names are first seen). Spellings are copied into per-shard arenas, so
+    // views returned by Name() stay valid for the table's lifetime.
+    //
+    // Safe to share between threads and lexers: names are spread over shards by
+    // hash, each with its own lock, arena and open-addressing index.
+    class SymbolTable {
+    public:
+        SymbolTable();
+        ~SymbolTable();
+        SymbolTable(const SymbolTable&) = delete;
+        SymbolTable& operator=(const SymbolTable&) = delete;
+
+        uint32_t Intern(string_view name);
+
+        // kNoSymbol if `name` was never interned.
+        uint32_t Find(string_view name) const;
+
+        // `id` must come from Intern() or Find().
+        string_view Name(uint32_t id) const;
+
+        size_t Size() const { return next_.load(memory_order_acquire); }
+
+    private:
+        struct Shard;
+
+        static constexpr size_t kShardCount = 64;
+
+        // IDs index a list of geometrically growing blocks, so entries never move
+        // and readers need no lock.
+        static constexpr unsigned kFirstBlockBits = 10;
+        static constexpr size_t   kBlockCount = 32 - kFirstBlockBits + 1;
+
+        string_view* Slot(uint32_t id) const;
+        string_view* GrowTo(uint32_t id);
+
+    private:
+        array<unique_ptr<Shard>, kShardCount>   shards_;
+        array<atomic<string_view*>, kBlockCount> blocks_{};
+        mutex                                   growLock_;
+        atomic<uint32_t>                        next_{ 0 };
+    };
+
+    // Fills stream.symbols for tokens [first, last): the interned ID of every
+    // Identifier and kNoSymbol for everything else.
+    void InternIdentifiers(CompactTokenStream& stream, SymbolTable& table, size_t first = 0, size_t last = SIZE_MAX);
+
+}
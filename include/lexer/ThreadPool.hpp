@@ -0,0 +1,56 @@
+#pragma once
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+using namespace std;
+
+namespace clex {
+
+    // Fixed-size pool where every worker owns a deque: it pops its own work from
+    // the back and steals from the front of the others when it runs dry.
+    class ThreadPool {
+    public:
+        explicit ThreadPool(size_t threads = 0);   // 0 = one worker per core
+        ~ThreadPool();
+
+        ThreadPool(const ThreadPool&) = delete;
+        ThreadPool& operator=(const ThreadPool&) = delete;
+
+        // Tasks submitted from a worker go to that worker's own deque.
+        void Submit(function<void()> task);
+
+        // Blocks until every submitted task has finished. Must not be called
+        // from inside a task.
+        void Wait();
+
+        size_t Size() const { return workers_.size(); }
+        static size_t DefaultSize();
+
+    private:
+        struct Worker {
+            mutex                    lock;
+            deque<function<void()>>  tasks;
+        };
+
+        bool TryPop(size_t self, function<void()>& task);
+        void Run(size_t self);
+
+    private:
+        vector<unique_ptr<Worker>> workers_;
+        vector<thread>             threads_;
+        atomic<size_t>             nextWorker_{ 0 };
+
+        mutex              stateLock_;
+        condition_variable wake_;
+        condition_variable idle_;
+        size_t             queued_ = 0;
+        size_t             pending_ = 0;
+        bool               stopping_ = false;
+    };
+
+}
@@ -1,5 +1,9 @@
 #pragma once
 #include <string>
+#include <string_view>
+#include <vector>
+#include <cstdint>
+#include <memory_resource>
 using namespace std;
 
 namespace clex {
@@ -10,15 +14,88 @@ namespace clex {
 		Error, EndOfFile
 	};
 
+	constexpr size_t kTokenKindCount = static_cast<size_t>(TokenKind::EndOfFile) + 1;
+
 	struct SourcePos { int line = 1; int column = 1; };
 
+	// Symbol ID of tokens that are not interned identifiers.
+	constexpr uint32_t kNoSymbol = 0xFFFFFFFFu;
+
 	struct Token {
 		TokenKind   kind{};
 		string      lexeme;
 		SourcePos   pos{};
 		string      message; 
+		uint32_t    symbol = kNoSymbol;
+	};
+
+	// Token whose strings allocate from a memory_resource, so a whole token
+	// vector can live in one arena and be released at once. Allocator-aware:
+	// a pmr::vector<PmrToken> hands its resource down to every element.
+	struct PmrToken {
+		using allocator_type = pmr::polymorphic_allocator<char>;
+
+		TokenKind   kind{};
+		pmr::string lexeme;
+		SourcePos   pos{};
+		pmr::string message;
+		uint32_t    symbol = kNoSymbol;
+
+		explicit PmrToken(const allocator_type& alloc = {});
+		PmrToken(TokenKind kind, string_view lexeme, SourcePos pos, string_view message, uint32_t symbol,
+			const allocator_type& alloc = {});
+		PmrToken(const PmrToken& other, const allocator_type& alloc);
+		PmrToken(PmrToken&& other, const allocator_type& alloc);
+		PmrToken(const PmrToken&) = default;
+		PmrToken(PmrToken&&) = default;
+		PmrToken& operator=(const PmrToken&) = default;
+		PmrToken& operator=(PmrToken&&) = default;
+	};
+
+	// 16-byte token that points into the lexer's source instead of owning its text.
+	// Columns are stored in 24 bits and saturate on absurdly long lines. Offsets
+	// and lengths are 32-bit, so sources past kMaxCompactSource bytes are turned
+	// away with a single Error token instead of being lexed.
+	struct CompactToken {
+		uint32_t offset;
+		uint32_t length;
+		uint32_t line;
+		uint32_t column : 24;
+		uint32_t kind : 8;
+
+		TokenKind Kind() const { return static_cast<TokenKind>(kind); }
+		SourcePos Pos() const { return { static_cast<int>(line), static_cast<int>(column) }; }
+	};
+
+	static_assert(sizeof(CompactToken) == 16, "CompactToken must stay 16 bytes");
+
+	inline constexpr size_t kMaxCompactSource = UINT32_MAX;
+
+	// Error messages live beside the token array, keyed by token index.
+	struct TokenDiagnostic {
+		uint32_t    token = 0;
+		string_view message;
 	};
 
+	struct CompactTokenStream {
+		string_view             source;
+		vector<CompactToken>    tokens;
+		vector<TokenDiagnostic> diagnostics;
+		vector<uint32_t>        symbols;      // parallel to tokens when identifiers are interned, else empty
+
+		string_view Lexeme(const CompactToken& t) const { return source.substr(t.offset, t.length); }
+		string_view Message(size_t tokenIndex) const;
+		Token Materialize(size_t tokenIndex) const;
+	};
+
+	CompactToken MakeCompactToken(TokenKind kind, size_t offset, size_t length, SourcePos pos);
+
+	// Position of the byte just past `t` in `source`, with `t`'s columns in code
+	// points when `codePoints` is set.
+	SourcePos TokenEndPosition(string_view source, const CompactToken& t, bool codePoints = false);
+
+	// Static name of `kind`, e.g. "Identifier" or "EOF"; to_string copies it.
+	string_view KindName(TokenKind kind);
 	string to_string(TokenKind);
 
 } 
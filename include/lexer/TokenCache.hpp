@@ -0,0 +1,53 @@
+#pragma once
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include "Lexer.hpp"
+#include "TokenFile.hpp"
+using namespace std;
+
+namespace clex {
+
+    // On-disk cache of token streams keyed by a hash of the input bytes, the
+    // lexer version and the options that affect the tokens. Entries are binary
+    // token files without a string table (the caller already has the source).
+    //
+    // Several processes may share one directory: entries are written to a temp
+    // file and renamed into place, and readers only ever see complete files.
+    // Hits refresh the entry's mtime; once the directory grows past `maxBytes`
+    // the least recently used entries are removed.
+    class TokenCache {
+    public:
+        static constexpr uint64_t kDefaultMaxBytes = 512ull << 20;
+
+        explicit TokenCache(string directory, uint64_t maxBytes = kDefaultMaxBytes);
+
+        // On a hit, maps the entry into `file` and fills `stream`, whose lexemes
+        // view `source` and whose messages view `file`.
+        bool Lookup(string_view source, const LexerOptions& options, TokenFile& file, CompactTokenStream& stream);
+
+        // Stores `stream`, lexed from `source` with `options`; false if the entry
+        // could not be written.
+        bool Store(string_view source, const LexerOptions& options, const CompactTokenStream& stream);
+
+        // Removes least recently used entries until the directory fits in maxBytes.
+        void Evict();
+
+        const string& Directory() const { return directory_; }
+
+    private:
+        string EntryPath(string_view source, const LexerOptions& options) const;
+
+    private:
+        string   directory_;
+        uint64_t maxBytes_;
+
+        // Bytes in the directory as of the last scan plus what this process has
+        // stored since; other processes' writes are picked up by the next scan.
+        mutex    lock_;
+        uint64_t knownBytes_ = 0;
+        bool     scanned_ = false;
+    };
+
+}
@@ -0,0 +1,101 @@
+#pragma once
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include "MappedFile.hpp"
+#include "Token.hpp"
+using namespace std;
+
+namespace clex {
+
+    // Binary token stream layout, in host byte order (little-endian on every
+    // supported target):
+    //
+    //   Header
+    //   Record[tokenCount]
+    //   DiagnosticRecord[diagnosticCount]
+    //   messages                          messageBytes bytes, referenced by diagnostics
+    //   source                            sourceBytes bytes, only with kHasSource
+    //
+    // Streams are self-delimiting, so several can be concatenated in one file.
+    namespace tokenfile {
+
+        constexpr char     kMagic[4] = { 'C', 'L', 'X', 'T' };
+        constexpr uint32_t kVersion = 1;
+        constexpr uint32_t kHasSource = 1u << 0;
+
+        struct Header {
+            char     magic[4];
+            uint32_t version;
+            uint32_t recordSize;
+            uint32_t flags;
+            uint64_t tokenCount;
+            uint64_t diagnosticCount;
+            uint64_t messageBytes;
+            uint64_t sourceBytes;
+        };
+
+        // Column in the low 24 bits, TokenKind in the high 8.
+        struct Record {
+            uint32_t offset;
+            uint32_t length;
+            uint32_t line;
+            uint32_t columnAndKind;
+        };
+
+        struct DiagnosticRecord {
+            uint32_t token;
+            uint32_t messageOffset;
+            uint32_t messageLength;
+        };
+
+        static_assert(sizeof(Header) == 48, "tokenfile::Header must stay 48 bytes");
+        static_assert(sizeof(Record) == 16, "tokenfile::Record must stay 16 bytes");
+        static_assert(sizeof(DiagnosticRecord) == 12, "tokenfile::DiagnosticRecord must stay 12 bytes");
+
+        // Bytes the encoded stream occupies.
+        size_t EncodedSize(const CompactTokenStream& stream, bool withSource);
+
+        // Appends the encoded stream to `out`.
+        void Encode(const CompactTokenStream& stream, bool withSource, string& out);
+
+    }
+
+    // Read-only access to one binary token stream. Records are decoded on access;
+    // nothing is copied up front.
+    class TokenFile {
+    public:
+        // Maps `path` and validates the first stream in it.
+        bool Open(const string& path);
+
+        // Validates a stream already in memory; `bytes` must outlive this object.
+        // `consumed` receives the stream's encoded size, to step over concatenated streams.
+        bool Load(string_view bytes, size_t* consumed = nullptr);
+
+        size_t TokenCount() const { return static_cast<size_t>(header_.tokenCount); }
+        CompactToken At(size_t index) const;
+
+        bool HasSource() const { return (header_.flags & tokenfile::kHasSource) != 0; }
+        string_view Source() const { return source_; }
+
+        // Every token and diagnostic; records are copied in one block, as they
+        // share CompactToken's layout. Lexemes and messages view the mapped
+        // bytes, so the stream is only valid while this object is alive.
+        CompactTokenStream ToStream() const;
+
+        const string& Error() const { return error_; }
+
+    private:
+        bool Fail(string message);
+
+    private:
+        MappedFile                         file_;
+        tokenfile::Header                  header_{};
+        const tokenfile::Record*           records_ = nullptr;
+        const tokenfile::DiagnosticRecord* diagnostics_ = nullptr;
+        string_view                        messages_;
+        string_view                        source_;
+        string                             error_;
+    };
+
+}
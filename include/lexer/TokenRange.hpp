@@ -0,0 +1,163 @@
+#pragma once
+#include <cstddef>
+#include <iterator>
+#include <utility>
+#include <vector>
+#include "Lexer.hpp"
+#include "Token.hpp"
+#if defined(__has_include)
+#if __has_include(<version>)
+#include <version>
+#endif
+#endif
+#if defined(__cpp_lib_ranges)
+#include <ranges>
+#endif
+using namespace std;
+
+namespace clex {
+
+    // Single-pass range over the tokens Lexer::TokenizeAll would return, pulled
+    // from the lexer a small batch at a time, so a pipeline holds a fixed number
+    // of tokens however long the input is. Iterators point back into the range:
+    // advancing one advances them all, and moving the range invalidates them.
+    class TokenRange
+#if defined(__cpp_lib_ranges)
+        : public ranges::view_base    // composes with views::filter, views::take, ...
+#endif
+    {
+    public:
+        class Iterator {
+        public:
+            using iterator_category = input_iterator_tag;
+            using value_type = Token;
+            using difference_type = ptrdiff_t;
+            using pointer = Token*;
+            using reference = Token&;
+
+            Iterator() = default;
+            explicit Iterator(TokenRange* range) : range_(range) {}
+
+            Token& operator*() const { return range_->batch_[range_->next_]; }
+            Token* operator->() const { return &range_->batch_[range_->next_]; }
+
+            Iterator& operator++() {
+                range_->Advance();
+                return *this;
+            }
+            void operator++(int) { ++*this; }
+
+            bool AtEnd() const { return !range_ || range_->next_ == range_->size_; }
+
+            friend bool operator==(const Iterator& a, const Iterator& b) { return a.AtEnd() == b.AtEnd(); }
+            friend bool operator!=(const Iterator& a, const Iterator& b) { return !(a == b); }
+
+        private:
+            TokenRange* range_ = nullptr;
+        };
+
+        explicit TokenRange(Lexer& lexer, size_t batchSize = kDefaultBatch)
+            : lexer_(&lexer), batch_(batchSize ? batchSize : 1) {}
+
+        // Pulls the first batch on the first call; later calls resume where the
+        // last iterator stopped.
+        Iterator begin() {
+            if (!started_) {
+                started_ = true;
+                Advance();
+            }
+            return Iterator(this);
+        }
+
+        // A default iterator compares equal to any exhausted one, which keeps
+        // begin() and end() the same type for C++17 algorithms.
+        Iterator end() { return Iterator(); }
+
+    private:
+        static constexpr size_t kDefaultBatch = 64;
+
+        void Advance() {
+            if (started_ && next_ + 1 < size_) {
+                ++next_;
+                return;
+            }
+            size_ = lexer_->NextBatch(batch_.data(), batch_.size());
+            next_ = 0;
+        }
+
+        Lexer*        lexer_;
+        vector<Token> batch_;
+        size_t        size_ = 0;
+        size_t        next_ = 0;
+        bool          started_ = false;
+    };
+
+    // C++17 stand-in for views::filter: the tokens of `range` that satisfy
+    // `pred`, skipped lazily as the range is walked. Filters nest.
+    template <class Range, class Pred>
+    class FilteredRange {
+        using Base = decltype(declval<Range&>().begin());
+
+    public:
+        class Iterator {
+        public:
+            using iterator_category = input_iterator_tag;
+            using value_type = Token;
+            using difference_type = ptrdiff_t;
+            using pointer = Token*;
+            using reference = Token&;
+
+            Iterator() = default;
+            Iterator(Base it, Base end, Pred* pred) : it_(it), end_(end), pred_(pred) { Skip(); }
+
+            Token& operator*() const { return *it_; }
+            Token* operator->() const { return &*it_; }
+
+            Iterator& operator++() {
+                ++it_;
+                Skip();
+                return *this;
+            }
+            void operator++(int) { ++*this; }
+
+            friend bool operator==(const Iterator& a, const Iterator& b) { return a.it_ == b.it_; }
+            friend bool operator!=(const Iterator& a, const Iterator& b) { return !(a == b); }
+
+        private:
+            void Skip() {
+                while (it_ != end_ && !(*pred_)(*it_)) ++it_;
+            }
+
+            Base  it_{};
+            Base  end_{};
+            Pred* pred_ = nullptr;
+        };
+
+        FilteredRange(Range range, Pred pred) : range_(move(range)), pred_(move(pred)) {}
+
+        Iterator begin() { return Iterator(range_.begin(), range_.end(), &pred_); }
+        Iterator end() { return Iterator(range_.end(), range_.end(), &pred_); }
+
+    private:
+        Range range_;
+        Pred  pred_;
+    };
+
+    template <class Range, class Pred>
+    FilteredRange<Range, Pred> Filter(Range range, Pred pred) {
+        return FilteredRange<Range, Pred>(move(range), move(pred));
+    }
+
+    // Predicates for the common filters.
+    struct KindIs {
+        TokenKind kind;
+        bool operator()(const Token& t) const { return t.kind == kind; }
+    };
+
+    struct KindIsNot {
+        TokenKind kind;
+        bool operator()(const Token& t) const { return t.kind != kind; }
+    };
+
+}
+
@@ -0,0 +1,67 @@
+#pragma once
+#include <cstdio>
+#include <string>
+#include <string_view>
+#include "DependencyScan.hpp"
+#include "Token.hpp"
+using namespace std;
+
+namespace clex {
+
+    // Text is the classic "<lexeme, Kind, line:column>" listing, JsonLines one
+    // JSON object per token, and Binary the mmap-able layout from TokenFile.hpp.
+    enum class OutputFormat { Text, JsonLines, Binary };
+
+    // Formats tokens into a large buffer and hands it to the sink in big blocks,
+    // so no per-token stream insertions or string allocations take place.
+    class TokenWriter {
+    public:
+        static constexpr size_t kDefaultBufferSize = 1 << 20;
+
+        TokenWriter(FILE* out, OutputFormat format, size_t bufferSize = kDefaultBufferSize);
+
+        // Appends everything to `out` on Flush() and on destruction.
+        TokenWriter(string& out, OutputFormat format, size_t bufferSize = kDefaultBufferSize);
+
+        ~TokenWriter();
+        TokenWriter(const TokenWriter&) = delete;
+        TokenWriter& operator=(const TokenWriter&) = delete;
+
+        // The binary format stores `stream.source` as its string table unless
+        // `withSource` is false.
+        void Write(const CompactTokenStream& stream, bool withSource = true);
+
+        // Text and JsonLines only; a binary stream needs the whole token array.
+        void Write(const Token& t);
+
+        // A file's directives: "path:line: #directive argument" lines (after a
+        // "path: guard MACRO" line for guarded headers) in text, one object per
+        // file in JSON Lines. Binary streams hold tokens only and get nothing.
+        void Write(string_view path, const DependencyRecord& deps);
+
+        // Separates files in batch output: "==> path <==" in text, {"file": ...}
+        // in JSON Lines. Binary streams are self-delimiting and get no header.
+        void WriteFileHeader(string_view path);
+
+        bool Flush();
+        bool Ok() const { return ok_; }
+
+    private:
+        void  Drain();
+        char* Reserve(size_t bytes);
+        void  Commit(char* end) { used_ = static_cast<size_t>(end - buffer_.data()); }
+
+        void  WriteText(string_view lexeme, TokenKind kind, uint32_t line, uint32_t column, string_view message);
+        void  WriteJson(string_view lexeme, TokenKind kind, uint32_t line, uint32_t column, string_view message,
+                        const CompactToken* compact);
+
+    private:
+        FILE*        file_ = nullptr;
+        string*      target_ = nullptr;
+        OutputFormat format_;
+        string       buffer_;
+        size_t       used_ = 0;
+        bool         ok_ = true;
+    };
+
+}
@@ -0,0 +1,55 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+using namespace std;
+
+namespace clex {
+
+    inline constexpr string_view kUtf8Bom = "\xEF\xBB\xBF";
+
+    // 3 when `text` starts with a UTF-8 byte order mark, else 0. Lexers start
+    // scanning after it, and it does not count towards line 1's columns.
+    inline size_t Utf8BomLength(string_view text) {
+        return text.substr(0, kUtf8Bom.size()) == kUtf8Bom ? kUtf8Bom.size() : 0;
+    }
+
+    // Length (1 to 4) of the well-formed UTF-8 sequence at p, with its code point
+    // in `cp`; 0 for overlong forms, surrogates, code points past U+10FFFF and
+    // sequences cut off by `avail`.
+    inline size_t DecodeUtf8(const char* p, size_t avail, uint32_t& cp) {
+        const unsigned char lead = static_cast<unsigned char>(p[0]);
+        size_t n;
+        uint32_t min;
+        if (lead < 0x80) {
+            cp = lead;
+            return 1;
+        }
+        if (lead >= 0xC2 && lead <= 0xDF) { n = 2; cp = lead & 0x1Fu; min = 0x80; }
+        else if (lead >= 0xE0 && lead <= 0xEF) { n = 3; cp = lead & 0x0Fu; min = 0x800; }
+        else if (lead >= 0xF0 && lead <= 0xF4) { n = 4; cp = lead & 0x07u; min = 0x10000; }
+        else return 0;
+
+        if (avail < n) return 0;
+        for (size_t i = 1; i < n; ++i) {
+            const unsigned char b = static_cast<unsigned char>(p[i]);
+            if ((b & 0xC0) != 0x80) return 0;
+            cp = (cp << 6) | (b & 0x3Fu);
+        }
+        if (cp < min || cp > 0x10FFFF || (cp >= 0xD800 && cp <= 0xDFFF)) return 0;
+        return n;
+    }
+
+    // Offset of the first byte of the first malformed sequence in `text`, npos
+    // when it is all valid UTF-8. Vectorized; meant as a pre-pass before lexing.
+    size_t FindInvalidUtf8(string_view text);
+
+    // Bytes of `text` that are not UTF-8 continuation bytes, i.e. its code
+    // points when it is valid.
+    size_t CountCodePoints(string_view text);
+
+    // Whether `cp` may appear in an identifier (at its start when `initial`),
+    // per the extended-character ranges of C11 Annex D.
+    bool IsIdentifierCodePoint(uint32_t cp, bool initial);
+
+}
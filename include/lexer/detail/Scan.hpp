@@ -0,0 +1,392 @@
+#pragma once
+#include <array>
+#include <cstring>
+#include <string_view>
+#include "../Keywords.hpp"
+#include "../LexerStats.hpp"
+#include "../Token.hpp"
+#include "../Utf8.hpp"
+#include "SimdScan.hpp"
+using namespace std;
+
+// Scan core of the dispatch engine, shared by Lexer and BasicLexer<Policy>.
+// Header-only so each policy gets its own instantiation with the switched-off
+// work compiled out.
+namespace clex::detail {
+
+    // A token before any text is copied: the lexeme is [offset, offset + length)
+    // of the source, and message is a static string for Error tokens.
+    struct RawToken {
+        TokenKind   kind{};
+        size_t      offset = 0;
+        size_t      length = 0;
+        SourcePos   pos{};
+        const char* message = nullptr;
+    };
+
+    // First-byte classes. Every byte that can start a token under the regex
+    // rules maps to the branch that reproduces them; bytes from 0x80 up may
+    // start a UTF-8 identifier.
+    enum class CharClass : unsigned char {
+        Unknown, Space, Hash, Slash, Quote, Apostrophe, Digit, Dot, IdentStart, Punct, Op, NonAscii
+    };
+
+    constexpr array<CharClass, 256> MakeCharClassTable() {
+        array<CharClass, 256> t{};
+        for (int c = 'a'; c <= 'z'; ++c) t[c] = CharClass::IdentStart;
+        for (int c = 'A'; c <= 'Z'; ++c) t[c] = CharClass::IdentStart;
+        for (int c = '0'; c <= '9'; ++c) t[c] = CharClass::Digit;
+        for (int c = 0x80; c <= 0xFF; ++c) t[c] = CharClass::NonAscii;
+        t['_'] = CharClass::IdentStart;
+        t[' '] = t['\t'] = t['\r'] = t['\n'] = CharClass::Space;
+        t['#'] = CharClass::Hash;
+        t['/'] = CharClass::Slash;
+        t['"'] = CharClass::Quote;
+        t['\''] = CharClass::Apostrophe;
+        t['.'] = CharClass::Dot;
+        for (char c : { '(', ')', ',', ';', '{', '}', '[', ']' }) t[static_cast<unsigned char>(c)] = CharClass::Punct;
+        for (char c : { '+', '-', '*', '%', '=', '!', '<', '>', '&', '|', '^', '~', '?', ':' }) {
+            t[static_cast<unsigned char>(c)] = CharClass::Op;
+        }
+        return t;
+    }
+
+    inline constexpr array<CharClass, 256> kCharClass = MakeCharClassTable();
+
+    inline bool IsDigit(unsigned char c) { return c >= '0' && c <= '9'; }
+
+    inline bool IsHexDigit(unsigned char c) {
+        return IsDigit(c) || (c >= 'a' && c <= 'f') || (c >= 'A' && c <= 'F');
+    }
+
+    inline bool IsIdentChar(unsigned char c) {
+        return kCharClass[c] == CharClass::IdentStart || kCharClass[c] == CharClass::Digit;
+    }
+
+    // Length of the UTF-8 character at p when it may appear in an identifier (at
+    // its start when `initial`), else 0. C89 has no extended characters.
+    inline size_t ExtendedIdentifierLength(const char* p, size_t avail, CStandard standard, bool initial) {
+        uint32_t cp;
+        const size_t n = standard == CStandard::C89 ? 0 : DecodeUtf8(p, avail, cp);
+        return n != 0 && IsIdentifierCodePoint(cp, initial) ? n : 0;
+    }
+
+    // End of the identifier whose first `i` bytes are already scanned. ASCII
+    // names pay one extra compare at their end for the UTF-8 check.
+    inline size_t ScanIdentifier(const char* p, size_t avail, size_t i, CStandard standard) {
+        while (true) {
+            while (i < avail && IsIdentChar(static_cast<unsigned char>(p[i]))) ++i;
+            if (i == avail || static_cast<unsigned char>(p[i]) < 0x80) return i;
+
+            const size_t n = ExtendedIdentifierLength(p + i, avail - i, standard, false);
+            if (n == 0) return i;
+            i += n;
+        }
+    }
+
+    // Error for a character that cannot start a token: a whole well-formed
+    // UTF-8 character, or a single byte of a malformed one.
+    inline size_t UnknownCharLength(const char* p, size_t avail, const char*& message) {
+        uint32_t cp;
+        const size_t n = DecodeUtf8(p, avail, cp);
+        message = n != 0 ? "Unknown token" : "Invalid UTF-8";
+        return n != 0 ? n : 1;
+    }
+
+    inline bool IsIntSuffix(unsigned char c) { return c == 'u' || c == 'U' || c == 'l' || c == 'L'; }
+
+    inline bool IsFloatSuffix(unsigned char c) { return c == 'f' || c == 'F' || c == 'l' || c == 'L'; }
+
+    inline size_t ScanToNewline(const char* p, size_t avail, size_t from) {
+        const void* nl = from < avail ? memchr(p + from, '\n', avail - from) : nullptr;
+        return nl ? static_cast<size_t>(static_cast<const char*>(nl) - p) : avail;
+    }
+
+    inline size_t ScanDigits(const char* p, size_t avail, size_t i) {
+        while (i < avail && IsDigit(static_cast<unsigned char>(p[i]))) ++i;
+        return i;
+    }
+
+    inline size_t ScanFloatSuffix(const char* p, size_t avail, size_t i) {
+        return (i < avail && IsFloatSuffix(static_cast<unsigned char>(p[i]))) ? i + 1 : i;
+    }
+
+    // Mirrors RX_INT_HEX, then RX_FLOAT (alternatives in their regex order), then RX_INT_DEC.
+    inline size_t ScanNumber(const char* p, size_t avail, TokenKind& kind) {
+        auto at = [&](size_t i) -> unsigned char { return i < avail ? static_cast<unsigned char>(p[i]) : 0; };
+
+        kind = TokenKind::IntLiteral;
+        if (p[0] == '0' && (at(1) == 'x' || at(1) == 'X') && IsHexDigit(at(2))) {
+            size_t i = 3;
+            while (IsHexDigit(at(i))) ++i;
+            while (IsIntSuffix(at(i))) ++i;
+            return i;
+        }
+
+        size_t digits = ScanDigits(p, avail, 1);
+        if (at(digits) == '.') {
+            kind = TokenKind::FloatLiteral;
+            return ScanFloatSuffix(p, avail, ScanDigits(p, avail, digits + 1));
+        }
+
+        if (at(digits) == 'e' || at(digits) == 'E') {
+            size_t i = digits + 1;
+            if (at(i) == '+' || at(i) == '-') ++i;
+            if (IsDigit(at(i))) {
+                kind = TokenKind::FloatLiteral;
+                return ScanFloatSuffix(p, avail, ScanDigits(p, avail, i));
+            }
+        }
+
+        while (IsIntSuffix(at(digits))) ++digits;
+        return digits;
+    }
+
+    // Returns the literal length, or 0 when RX_STRING would not match. Like the
+    // regex, raw newlines are allowed in the body but an escape must not be
+    // followed by a line terminator.
+    inline size_t ScanStringBody(const simd::Kernels& simd, const char* p, size_t avail) {
+        size_t i = 1;
+        while (true) {
+            i += simd.findQuoteOrEscape(p + i, avail - i, '"');
+            if (i >= avail) return 0;
+            if (p[i] == '"') return i + 1;
+            if (i + 1 >= avail || p[i + 1] == '\n' || p[i + 1] == '\r') return 0;
+            i += 2;
+        }
+    }
+
+    inline size_t ScanCharBody(const char* p, size_t avail) {
+        size_t i = 1;
+        if (i >= avail || p[i] == '\'') return 0;
+        if (p[i] == '\\') {
+            if (i + 1 >= avail || p[i + 1] == '\n' || p[i + 1] == '\r') return 0;
+            i += 2;
+        }
+        else {
+            ++i;
+        }
+        return (i < avail && p[i] == '\'') ? i + 1 : 0;
+    }
+
+    // Longest operator starting at p[0]; RX_OP_ALL lists its alternatives so
+    // that the first one to match is also the longest.
+    inline size_t ScanOperator(const char* p, size_t avail) {
+        char c0 = p[0];
+        char c1 = avail > 1 ? p[1] : '\0';
+        char c2 = avail > 2 ? p[2] : '\0';
+
+        switch (c0) {
+        case '<':
+        case '>':
+            if (c1 == c0) return c2 == '=' ? 3 : 2;
+            return c1 == '=' ? 2 : 1;
+        case '=': case '!': case '*': case '%': case '^':
+            return c1 == '=' ? 2 : 1;
+        case '&': case '|': case '+':
+            return (c1 == c0 || c1 == '=') ? 2 : 1;
+        case '-':
+            return (c1 == '-' || c1 == '=' || c1 == '>') ? 2 : 1;
+        default:
+            return 1;
+        }
+    }
+
+    // Columns taken up by `text`, which holds no newline.
+    template <bool CodePoints>
+    inline size_t ColumnsOf(const simd::Kernels& simd, const char* text, size_t length) {
+        if constexpr (CodePoints) return simd.countCodePoints(text, length);
+        else return length;
+    }
+
+    // Moves the cursor over `text`, which may span lines. Columns count code
+    // points instead of bytes when CodePoints is set.
+    template <bool CodePoints = false>
+    inline void Advance(const simd::Kernels& simd, string_view text, size_t& index, int& line, int& column) {
+        size_t newlines = simd.countNewlines(text.data(), text.size());
+        index += text.size();
+
+        if (newlines == 0) {
+            column += static_cast<int>(ColumnsOf<CodePoints>(simd, text.data(), text.size()));
+            return;
+        }
+
+        const size_t lastLine = text.rfind('\n') + 1;
+        line += static_cast<int>(newlines);
+        column = 1 + static_cast<int>(ColumnsOf<CodePoints>(simd, text.data() + lastLine, text.size() - lastLine));
+    }
+
+    // The rule a dispatch-scanned token (or failed attempt) is accounted to.
+    inline LexRule RuleOf(TokenKind kind, const char* p, size_t length) {
+        switch (kind) {
+        case TokenKind::Preprocessor:  return LexRule::Preprocessor;
+        case TokenKind::Comment:       return p[1] == '/' ? LexRule::LineComment : LexRule::BlockComment;
+        case TokenKind::StringLiteral: return LexRule::StringLiteral;
+        case TokenKind::CharLiteral:   return LexRule::CharLiteral;
+        case TokenKind::FloatLiteral:  return LexRule::Float;
+        case TokenKind::IntLiteral:    return length > 2 && (p[1] == 'x' || p[1] == 'X') ? LexRule::HexInt : LexRule::DecInt;
+        case TokenKind::Identifier:
+        case TokenKind::Keyword:       return LexRule::Identifier;
+        case TokenKind::Error:
+            if (*p == '/') return LexRule::BlockComment;
+            if (*p == '"') return LexRule::StringLiteral;
+            if (*p == '\'') return LexRule::CharLiteral;
+            return LexRule::Unknown;
+        default:                       return LexRule::Operator;
+        }
+    }
+
+    // Scans the next token at `index` that Policy keeps. Only Policy::kPositions,
+    // kCodePointColumns, kComments and kPreprocessor matter here: untracked
+    // scans leave line and column alone and report {0, 0}, and dropped kinds are
+    // stepped over like whitespace. Returns false at end of input. With
+    // CLEX_STATS, every rule taken is accounted to `stats` when it is not null.
+    template <class Policy>
+    bool ScanToken(string_view source, CStandard standard, size_t& index, int& line, int& column, RawToken& out,
+                   LexerStats* stats = nullptr) {
+        const char* const base = source.data();
+        const size_t size = source.size();
+        const simd::Kernels& simd = simd::Active();
+
+        while (index < size) {
+            const size_t start = index;
+            const char* p = base + start;
+            const size_t avail = size - start;
+            auto at = [&](size_t i) -> unsigned char { return i < avail ? static_cast<unsigned char>(p[i]) : 0; };
+
+            RuleProbe probe(stats);
+            const SourcePos pos{ line, column };
+            TokenKind kind = TokenKind::Operator;
+            size_t len = 1;
+            const char* message = nullptr;
+            bool multiline = false;
+
+            switch (kCharClass[static_cast<unsigned char>(*p)]) {
+            case CharClass::Space: {
+                const size_t run = simd.skipWhitespace(p, avail);
+                if constexpr (Policy::kPositions) Advance(simd, string_view(p, run), index, line, column);
+                else index += run;
+                probe.Record(LexRule::Whitespace, true, run);
+                continue;
+            }
+
+            case CharClass::Hash:
+                kind = TokenKind::Preprocessor;
+                len = ScanToNewline(p, avail, 1);
+                break;
+
+            case CharClass::Slash:
+                if (at(1) == '/') {
+                    kind = TokenKind::Comment;
+                    len = ScanToNewline(p, avail, 2);
+                }
+                else if (at(1) == '*') {
+                    size_t close = 2 + simd.findCommentEnd(p + 2, avail - 2);
+                    multiline = true;
+                    if (close >= avail) {
+                        kind = TokenKind::Error;
+                        len = avail;
+                        message = "Unterminated block comment";
+                    }
+                    else {
+                        kind = TokenKind::Comment;
+                        len = close + 2;
+                    }
+                }
+                else if (at(1) == '=') len = 2;
+                break;
+
+            case CharClass::Quote:
+            case CharClass::Apostrophe: {
+                const bool isString = *p == '"';
+                size_t end = isString ? ScanStringBody(simd, p, avail) : ScanCharBody(p, avail);
+                if (end != 0) {
+                    kind = isString ? TokenKind::StringLiteral : TokenKind::CharLiteral;
+                    len = end;
+                    multiline = true;
+                }
+                else {
+                    kind = TokenKind::Error;
+                    len = ScanToNewline(p, avail, 1);
+                    message = isString ? "Unterminated string" : "Unterminated char literal";
+                }
+                break;
+            }
+
+            case CharClass::Digit:
+                len = ScanNumber(p, avail, kind);
+                break;
+
+            case CharClass::Dot:
+                if (IsDigit(at(1))) {
+                    kind = TokenKind::FloatLiteral;
+                    len = ScanFloatSuffix(p, avail, ScanDigits(p, avail, 1));
+                }
+                else if (at(1) == '.' && at(2) == '.') {
+                    kind = TokenKind::Ellipsis;
+                    len = 3;
+                }
+                break;
+
+            case CharClass::IdentStart:
+                len = ScanIdentifier(p, avail, 1, standard);
+                {
+                    RuleProbe lookup(stats);
+                    kind = IsKeyword(string_view(p, len), standard) ? TokenKind::Keyword : TokenKind::Identifier;
+                    lookup.Record(LexRule::KeywordLookup, kind == TokenKind::Keyword, len);
+                }
+                break;
+
+            case CharClass::Punct:
+                kind = TokenKind::Punctuator;
+                break;
+
+            case CharClass::Op:
+                len = ScanOperator(p, avail);
+                break;
+
+            case CharClass::NonAscii:
+                if (size_t n = ExtendedIdentifierLength(p, avail, standard, true)) {
+                    kind = TokenKind::Identifier;   // never a keyword
+                    len = ScanIdentifier(p, avail, n, standard);
+                }
+                else {
+                    kind = TokenKind::Error;
+                    len = UnknownCharLength(p, avail, message);
+                }
+                break;
+
+            case CharClass::Unknown:
+                kind = TokenKind::Error;
+                message = "Unknown token";
+                break;
+            }
+
+            if constexpr (kStatsEnabled) probe.Record(RuleOf(kind, p, len), kind != TokenKind::Error, len);
+
+            if constexpr (Policy::kPositions) {
+                if (multiline) Advance<Policy::kCodePointColumns>(simd, string_view(p, len), index, line, column);
+                else {
+                    index += len;
+                    column += static_cast<int>(ColumnsOf<Policy::kCodePointColumns>(simd, p, len));
+                }
+            }
+            else {
+                index += len;
+            }
+
+            if constexpr (!Policy::kComments) {
+                if (kind == TokenKind::Comment) continue;
+            }
+            if constexpr (!Policy::kPreprocessor) {
+                if (kind == TokenKind::Preprocessor) continue;
+            }
+
+            out = RawToken{ kind, start, len, Policy::kPositions ? pos : SourcePos{ 0, 0 }, message };
+            return true;
+        }
+
+        return false;
+    }
+
+}
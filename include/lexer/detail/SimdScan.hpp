@@ -0,0 +1,28 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace clex::simd {
+
+    // Bulk-skip kernels for the dispatch engine. Every function returns an offset
+    // in [0, n]; n means "not found".
+    struct Kernels {
+        const char* name;
+        size_t (*skipWhitespace)(const char* p, size_t n);           // first byte not in [ \t\r\n]
+        size_t (*findCommentEnd)(const char* p, size_t n);           // start of the first "*/"
+        size_t (*findQuoteOrEscape)(const char* p, size_t n, char quote);
+        size_t (*countNewlines)(const char* p, size_t n);
+        void   (*appendNewlines)(const char* p, size_t n, size_t base, std::vector<size_t>& out); // base + i per '\n'
+        size_t (*validateUtf8)(const char* p, size_t n);             // first byte of the first malformed sequence
+        size_t (*countCodePoints)(const char* p, size_t n);          // bytes outside [0x80, 0xBF]
+    };
+
+    const Kernels& Scalar();
+    const Kernels* Sse2();   // nullptr when the CPU or compiler lacks the instruction set
+    const Kernels* Avx2();
+
+    // Best kernels for this CPU, chosen once through CPUID.
+    const Kernels& Active();
+
+}
@@ -0,0 +1,365 @@
+#include "lexer/DependencyScan.hpp"
+#include "lexer/Utf8.hpp"
+#include "lexer/detail/Scan.hpp"
+#include "lexer/detail/SimdScan.hpp"
+#include <array>
+#include <cstring>
+using namespace std;
+
+namespace clex {
+
+    namespace {
+
+        // Bytes that end the fast skip over a code line.
+        constexpr array<bool, 256> kCodeStops = [] {
+            array<bool, 256> t{};
+            t['\n'] = t['/'] = t['"'] = t['\''] = t['\\'] = true;
+            return t;
+        }();
+
+        constexpr struct {
+            string_view   name;
+            DirectiveKind kind;
+        } kDirectives[] = {
+            { "include", DirectiveKind::Include }, { "include_next", DirectiveKind::IncludeNext },
+            { "import", DirectiveKind::Import },   { "define", DirectiveKind::Define },
+            { "undef", DirectiveKind::Undef },     { "if", DirectiveKind::If },
+            { "ifdef", DirectiveKind::Ifdef },     { "ifndef", DirectiveKind::Ifndef },
+            { "elif", DirectiveKind::Elif },       { "elifdef", DirectiveKind::Elifdef },
+            { "elifndef", DirectiveKind::Elifndef }, { "else", DirectiveKind::Else },
+            { "endif", DirectiveKind::Endif },     { "pragma", DirectiveKind::Pragma },
+        };
+
+        DirectiveKind Classify(string_view name) {
+            for (const auto& d : kDirectives) {
+                if (d.name == name) return d.kind;
+            }
+            return DirectiveKind::Other;
+        }
+
+        bool IsBlank(char c) { return c == ' ' || c == '\t' || c == '\r' || c == '\f' || c == '\v'; }
+
+        class Cursor {
+        public:
+            explicit Cursor(string_view source) : p_(source.data()), n_(source.size()) {}
+
+            const char* p_;
+            size_t      n_;
+            size_t      i_ = 0;
+            uint32_t    line_ = 1;
+
+            bool At(size_t k, char c) const { return i_ + k < n_ && p_[i_ + k] == c; }
+
+            // Length of a backslash-newline at the cursor, 0 if there is none.
+            size_t Continuation() const {
+                if (p_[i_] != '\\') return 0;
+                if (At(1, '\n')) return 2;
+                return At(1, '\r') && At(2, '\n') ? 3 : 0;
+            }
+
+            void SkipContinuation(size_t length) {
+                i_ += length;
+                ++line_;
+            }
+
+            void SkipBlockComment() {
+                const size_t start = i_;
+                size_t j = i_ + 2;
+                while (true) {
+                    const void* star = j < n_ ? memchr(p_ + j, '*', n_ - j) : nullptr;
+                    if (!star) {
+                        j = n_;
+                        break;
+                    }
+                    j = static_cast<size_t>(static_cast<const char*>(star) - p_) + 1;
+                    if (j < n_ && p_[j] == '/') {
+                        ++j;
+                        break;
+                    }
+                }
+                line_ += static_cast<uint32_t>(simd::Active().countNewlines(p_ + start, j - start));
+                i_ = j;
+            }
+
+            // Stops at the newline that ends the comment; a continuation extends it.
+            void SkipLineComment() {
+                while (true) {
+                    const void* nl = memchr(p_ + i_, '\n', n_ - i_);
+                    if (!nl) {
+                        i_ = n_;
+                        return;
+                    }
+                    size_t j = static_cast<size_t>(static_cast<const char*>(nl) - p_);
+                    size_t k = j;
+                    if (k > i_ && p_[k - 1] == '\r') --k;
+                    if (k == i_ || p_[k - 1] != '\\') {
+                        i_ = j;
+                        return;
+                    }
+                    ++line_;
+                    i_ = j + 1;
+                }
+            }
+
+            // A literal ends at its closing quote or, unterminated, at the end of the line.
+            void SkipLiteral() {
+                const char quote = p_[i_++];
+                while (i_ < n_) {
+                    const char c = p_[i_];
+                    if (c == quote) {
+                        ++i_;
+                        return;
+                    }
+                    if (c == '\n') return;
+                    if (c == '\\') {
+                        if (size_t len = Continuation()) SkipContinuation(len);
+                        else i_ = min(i_ + 2, n_);
+                        continue;
+                    }
+                    ++i_;
+                }
+            }
+
+            // Whitespace, continuations and block comments within a logical line.
+            void SkipBlanks() {
+                while (i_ < n_) {
+                    if (IsBlank(p_[i_])) ++i_;
+                    else if (size_t len = Continuation()) SkipContinuation(len);
+                    else if (p_[i_] == '/' && At(1, '*')) SkipBlockComment();
+                    else return;
+                }
+            }
+
+            string_view Identifier() {
+                const size_t start = i_;
+                while (i_ < n_ && detail::IsIdentChar(static_cast<unsigned char>(p_[i_]))) ++i_;
+                return string_view(p_ + start, i_ - start);
+            }
+
+            // Header name up to `close` on the same line; empty, with the cursor
+            // left alone, when the line ends first.
+            string_view Delimited(char close) {
+                size_t j = i_ + 1;
+                while (j < n_ && p_[j] != close && p_[j] != '\n') ++j;
+                if (j >= n_ || p_[j] != close) return {};
+                string_view path(p_ + i_ + 1, j - i_ - 1);
+                i_ = j + 1;
+                return path;
+            }
+
+            // Moves to the newline that ends the logical line (or the end of input)
+            // and returns the end of its last byte that is not blank or a comment.
+            size_t SkipRestOfLine() {
+                size_t contentEnd = i_;
+                while (i_ < n_) {
+                    const char c = p_[i_];
+                    if (c == '\n') break;
+                    if (size_t len = Continuation()) SkipContinuation(len);
+                    else if (c == '/' && At(1, '*')) SkipBlockComment();
+                    else if (c == '/' && At(1, '/')) SkipLineComment();
+                    else if (c == '"' || c == '\'') {
+                        SkipLiteral();
+                        contentEnd = i_;
+                    }
+                    else {
+                        ++i_;
+                        if (!IsBlank(c)) contentEnd = i_;
+                    }
+                }
+                return contentEnd;
+            }
+        };
+
+        // The cursor is on the '#'; leaves it on the newline ending the directive.
+        Directive ParseDirective(Cursor& c) {
+            Directive d;
+            d.offset = static_cast<uint32_t>(c.i_);
+            d.line = c.line_;
+            ++c.i_;
+
+            c.SkipBlanks();
+            d.name = c.Identifier();
+            d.kind = d.name.empty() ? DirectiveKind::Other : Classify(d.name);
+            c.SkipBlanks();
+
+            switch (d.kind) {
+            case DirectiveKind::Include:
+            case DirectiveKind::IncludeNext:
+            case DirectiveKind::Import:
+                if (c.i_ < c.n_ && (c.p_[c.i_] == '<' || c.p_[c.i_] == '"')) {
+                    const bool angled = c.p_[c.i_] == '<';
+                    d.argument = c.Delimited(angled ? '>' : '"');
+                    if (d.argument.data()) d.form = angled ? IncludeForm::Angled : IncludeForm::Quoted;
+                }
+                else {
+                    d.argument = c.Identifier();
+                    if (!d.argument.empty()) d.form = IncludeForm::Macro;
+                }
+                break;
+
+            case DirectiveKind::Define:
+            case DirectiveKind::Undef:
+            case DirectiveKind::Ifdef:
+            case DirectiveKind::Ifndef:
+            case DirectiveKind::Elifdef:
+            case DirectiveKind::Elifndef:
+                d.argument = c.Identifier();
+                break;
+
+            default: {
+                const size_t start = c.i_;
+                d.argument = string_view(c.p_ + start, c.SkipRestOfLine() - start);
+                return d;
+            }
+            }
+
+            c.SkipRestOfLine();
+            return d;
+        }
+
+        // "!defined(X)" or "!defined X", as an #if guard condition.
+        string_view NegatedDefined(string_view text) {
+            size_t i = 0;
+            auto blanks = [&] { while (i < text.size() && IsBlank(text[i])) ++i; };
+            auto eat = [&](string_view word) {
+                blanks();
+                if (text.substr(i, word.size()) != word) return false;
+                i += word.size();
+                return true;
+            };
+
+            if (!eat("!") || !eat("defined")) return {};
+            const bool paren = eat("(");
+            blanks();
+            const size_t start = i;
+            while (i < text.size() && detail::IsIdentChar(static_cast<unsigned char>(text[i]))) ++i;
+            string_view name = text.substr(start, i - start);
+            if (paren && !eat(")")) return {};
+            blanks();
+            return i == text.size() ? name : string_view();
+        }
+
+        // The guard macro when the first directive is #ifndef X (or #if !defined X),
+        // the second #define X, and the matching #endif is the last directive with
+        // no code outside the pair.
+        string_view FindGuard(const vector<Directive>& ds, size_t firstCode, size_t lastCode) {
+            if (ds.size() < 3) return {};
+
+            string_view macro = ds[0].kind == DirectiveKind::Ifndef ? ds[0].argument
+                : ds[0].kind == DirectiveKind::If ? NegatedDefined(ds[0].argument) : string_view();
+            if (macro.empty() || ds[1].kind != DirectiveKind::Define || ds[1].argument != macro) return {};
+
+            size_t depth = 0;
+            for (size_t k = 0; k < ds.size(); ++k) {
+                switch (ds[k].kind) {
+                case DirectiveKind::If:
+                case DirectiveKind::Ifdef:
+                case DirectiveKind::Ifndef:
+                    ++depth;
+                    break;
+                case DirectiveKind::Elif:
+                case DirectiveKind::Elifdef:
+                case DirectiveKind::Elifndef:
+                case DirectiveKind::Else:
+                    if (depth == 1) return {};
+                    break;
+                case DirectiveKind::Endif:
+                    if (--depth == 0) {
+                        if (k != ds.size() - 1) return {};
+                        const bool enclosed = firstCode == string_view::npos
+                            || (firstCode > ds[0].offset && lastCode <= ds[k].offset);
+                        return enclosed ? macro : string_view();
+                    }
+                    break;
+                default:
+                    break;
+                }
+            }
+            return {};
+        }
+
+    }
+
+    string_view DirectiveName(DirectiveKind kind) {
+        for (const auto& d : kDirectives) {
+            if (d.kind == kind) return d.name;
+        }
+        return "other";
+    }
+
+    size_t DependencyRecord::IncludeCount() const {
+        size_t count = 0;
+        for (const Directive& d : directives) {
+            count += d.kind == DirectiveKind::Include || d.kind == DirectiveKind::IncludeNext || d.kind == DirectiveKind::Import;
+        }
+        return count;
+    }
+
+    DependencyRecord ScanDependencies(string_view source) {
+        DependencyRecord record;
+        Cursor c(source);
+        c.i_ = Utf8BomLength(source);
+        const char* const p = source.data();
+        const size_t n = source.size();
+
+        bool lineStart = true;   // nothing but blanks and comments so far on this line
+        size_t firstCode = string_view::npos;
+        size_t lastCode = 0;
+        auto code = [&](size_t start, size_t end) {
+            if (firstCode == string_view::npos) firstCode = start;
+            lastCode = end;
+            lineStart = false;
+        };
+
+        while (c.i_ < n) {
+            const size_t start = c.i_;
+            switch (p[start]) {
+            case '\n':
+                ++c.line_;
+                ++c.i_;
+                lineStart = true;
+                break;
+
+            case ' ': case '\t': case '\r': case '\f': case '\v':
+                ++c.i_;
+                break;
+
+            case '\\':
+                if (size_t len = c.Continuation()) c.SkipContinuation(len);
+                else code(start, ++c.i_);
+                break;
+
+            case '/':
+                if (c.At(1, '*')) c.SkipBlockComment();
+                else if (c.At(1, '/')) c.SkipLineComment();
+                else code(start, ++c.i_);
+                break;
+
+            case '"':
+            case '\'':
+                c.SkipLiteral();
+                code(start, c.i_);
+                break;
+
+            case '#':
+                if (lineStart) {
+                    record.directives.push_back(ParseDirective(c));
+                    break;
+                }
+                [[fallthrough]];
+
+            default: {
+                size_t i = start + 1;
+                while (i < n && !kCodeStops[static_cast<unsigned char>(p[i])]) ++i;
+                c.i_ = i;
+                code(start, i);
+                break;
+            }
+            }
+        }
+
+        record.guard = FindGuard(record.directives, firstCode, lastCode);
+        return record;
+    }
+
+}
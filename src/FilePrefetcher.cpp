@@ -0,0 +1,413 @@
+#include "lexer/FilePrefetcher.hpp"
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cstring>
+
+#ifdef _WIN32
+#include <io.h>
+#include <fcntl.h>
+#else
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#if defined(__linux__) && defined(__has_include)
+#if __has_include(<linux/io_uring.h>)
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#if defined(__NR_io_uring_setup) && defined(IORING_FEAT_FAST_POLL)   // headers new enough for IORING_OP_READ
+#define CLEX_HAVE_IO_URING 1
+#endif
+#endif
+#endif
+using namespace std;
+
+namespace clex {
+
+    namespace {
+
+        using Clock = chrono::steady_clock;
+
+        double SecondsSince(Clock::time_point start) {
+            return chrono::duration<double>(Clock::now() - start).count();
+        }
+
+        // Largest single read request; io_uring lengths are 32-bit.
+        constexpr size_t kMaxRead = size_t(1) << 30;
+
+        // Reading is mostly waiting, so a few threads keep a deep queue busy.
+        constexpr size_t kMaxReaderThreads = 4;
+
+#ifdef _WIN32
+        int OpenForRead(const string& path) {
+            if (path == "-") { _setmode(0, _O_BINARY); return 0; }
+            return _open(path.c_str(), _O_RDONLY | _O_BINARY | _O_SEQUENTIAL);
+        }
+
+        void CloseFd(int fd) { if (fd != 0) _close(fd); }
+
+        long long ReadSome(int fd, char* p, size_t n, size_t) {
+            return _read(fd, p, static_cast<unsigned>(min(n, kMaxRead)));
+        }
+
+        bool RegularSize(int, size_t&) { return false; }
+#else
+        int OpenForRead(const string& path) {
+            return path == "-" ? STDIN_FILENO : open(path.c_str(), O_RDONLY | O_CLOEXEC);
+        }
+
+        void CloseFd(int fd) { if (fd != STDIN_FILENO) close(fd); }
+
+        long long ReadSome(int fd, char* p, size_t n, size_t offset) {
+            return pread(fd, p, min(n, kMaxRead), static_cast<off_t>(offset));
+        }
+
+        // Size of a regular file, after telling the kernel it will be read front
+        // to back; false for pipes and devices, which have no size up front.
+        bool RegularSize(int fd, size_t& size) {
+            struct stat st {};
+            if (fstat(fd, &st) != 0 || !S_ISREG(st.st_mode)) return false;
+            size = static_cast<size_t>(st.st_size);
+#ifdef POSIX_FADV_SEQUENTIAL
+            posix_fadvise(fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+#endif
+            return true;
+        }
+#endif
+
+        // Reads all of `fd` into `buffer`, reusing its capacity. Regular files are
+        // read up to the size they had when opened, like a mapping would see.
+        bool ReadWhole(int fd, string& buffer, size_t& size, string& error) {
+            size_t expected = 0;
+            const bool regular = RegularSize(fd, expected);
+            if (regular) buffer.resize(expected);
+
+            size = 0;
+            while (!regular || size < expected) {
+                if (!regular && buffer.size() - size < 64 * 1024) buffer.resize(buffer.size() + max<size_t>(64 * 1024, buffer.size()));
+                long long n = regular ? ReadSome(fd, &buffer[size], expected - size, size)
+#ifdef _WIN32
+                    : ReadSome(fd, &buffer[size], buffer.size() - size, size);
+#else
+                    : read(fd, &buffer[size], buffer.size() - size);
+#endif
+                if (n < 0 && errno == EINTR) continue;
+                if (n < 0) { error = strerror(errno); return false; }
+                if (n == 0) break;
+                size += static_cast<size_t>(n);
+            }
+            return true;
+        }
+
+    }
+
+#ifdef CLEX_HAVE_IO_URING
+    // A submission and completion ring mapped straight from the kernel, so no
+    // liburing is needed. Only the I/O thread touches it.
+    struct FilePrefetcher::Ring {
+        int           fd = -1;
+        void*         sq = MAP_FAILED;
+        size_t        sqBytes = 0;
+        void*         cq = MAP_FAILED;
+        size_t        cqBytes = 0;
+        io_uring_sqe* sqes = static_cast<io_uring_sqe*>(MAP_FAILED);
+        size_t        sqesBytes = 0;
+
+        unsigned*     sqTail = nullptr;
+        unsigned*     sqMask = nullptr;
+        unsigned*     sqArray = nullptr;
+        unsigned*     cqHead = nullptr;
+        unsigned*     cqTail = nullptr;
+        unsigned*     cqMask = nullptr;
+        io_uring_cqe* cqes = nullptr;
+        unsigned      pending = 0;   // queued but not yet passed to io_uring_enter
+
+        ~Ring() {
+            if (sqes != MAP_FAILED) munmap(sqes, sqesBytes);
+            if (cq != MAP_FAILED && cq != sq) munmap(cq, cqBytes);
+            if (sq != MAP_FAILED) munmap(sq, sqBytes);
+            if (fd >= 0) close(fd);
+        }
+
+        // Fails on kernels without IORING_OP_READ (before 5.7) or where seccomp
+        // forbids io_uring, which is when the thread readers take over.
+        bool Setup(unsigned entries) {
+            io_uring_params p {};
+            fd = static_cast<int>(syscall(__NR_io_uring_setup, entries, &p));
+            if (fd < 0 || !(p.features & IORING_FEAT_FAST_POLL)) return false;
+
+            sqBytes = p.sq_off.array + p.sq_entries * sizeof(unsigned);
+            cqBytes = p.cq_off.cqes + p.cq_entries * sizeof(io_uring_cqe);
+            const bool single = p.features & IORING_FEAT_SINGLE_MMAP;
+            if (single) sqBytes = cqBytes = max(sqBytes, cqBytes);
+
+            sq = mmap(nullptr, sqBytes, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQ_RING);
+            if (sq == MAP_FAILED) return false;
+            cq = single ? sq : mmap(nullptr, cqBytes, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_CQ_RING);
+            if (cq == MAP_FAILED) return false;
+            sqesBytes = p.sq_entries * sizeof(io_uring_sqe);
+            sqes = static_cast<io_uring_sqe*>(mmap(nullptr, sqesBytes, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQES));
+            if (sqes == MAP_FAILED) return false;
+
+            char* s = static_cast<char*>(sq);
+            char* c = static_cast<char*>(cq);
+            sqTail = reinterpret_cast<unsigned*>(s + p.sq_off.tail);
+            sqMask = reinterpret_cast<unsigned*>(s + p.sq_off.ring_mask);
+            sqArray = reinterpret_cast<unsigned*>(s + p.sq_off.array);
+            cqHead = reinterpret_cast<unsigned*>(c + p.cq_off.head);
+            cqTail = reinterpret_cast<unsigned*>(c + p.cq_off.tail);
+            cqMask = reinterpret_cast<unsigned*>(c + p.cq_off.ring_mask);
+            cqes = reinterpret_cast<io_uring_cqe*>(c + p.cq_off.cqes);
+            return true;
+        }
+
+        // Queues a read into `p`; at most one per slot is outstanding, and the
+        // ring has at least as many entries as there are slots.
+        void QueueRead(int file, char* p, size_t n, size_t offset, uint64_t tag) {
+            const unsigned tail = *sqTail + pending;
+            const unsigned i = tail & *sqMask;
+            io_uring_sqe& e = sqes[i];
+            memset(&e, 0, sizeof e);
+            e.opcode = IORING_OP_READ;
+            e.fd = file;
+            e.addr = reinterpret_cast<uint64_t>(p);
+            e.len = static_cast<unsigned>(min(n, kMaxRead));
+            e.off = offset;
+            e.user_data = tag;
+            sqArray[i] = i;
+            ++pending;
+        }
+
+        // Submits what was queued and blocks until at least one read completes.
+        bool SubmitAndWait() {
+            __atomic_store_n(sqTail, *sqTail + pending, __ATOMIC_RELEASE);
+            unsigned submit = pending;
+            pending = 0;
+            while (syscall(__NR_io_uring_enter, fd, submit, 1u, IORING_ENTER_GETEVENTS, nullptr, 0) < 0) {
+                if (errno != EINTR && errno != EAGAIN && errno != EBUSY) return false;
+                submit = 0;   // the kernel took the entries before the interruption
+            }
+            return true;
+        }
+
+        bool Reap(uint64_t& tag, int& result) {
+            const unsigned head = *cqHead;
+            if (head == __atomic_load_n(cqTail, __ATOMIC_ACQUIRE)) return false;
+            const io_uring_cqe& e = cqes[head & *cqMask];
+            tag = e.user_data;
+            result = e.res;
+            __atomic_store_n(cqHead, head + 1, __ATOMIC_RELEASE);
+            return true;
+        }
+    };
+#else
+    struct FilePrefetcher::Ring {};
+#endif
+
+    FilePrefetcher::FilePrefetcher(vector<string> paths, size_t depth, Backend backend)
+        : paths_(move(paths)), slots_(min<size_t>(max<size_t>(depth, 1), 4096)), loaded_(paths_.size()) {
+#ifdef CLEX_HAVE_IO_URING
+        if (backend != Backend::Threads) {
+            auto ring = make_unique<Ring>();
+            if (ring->Setup(static_cast<unsigned>(slots_.size()))) ring_ = move(ring);
+        }
+#else
+        (void)backend;
+#endif
+        if (ring_) {
+            readers_.emplace_back([this] { RunRing(); });
+            return;
+        }
+
+        const size_t readers = min(slots_.size(), kMaxReaderThreads);
+        for (size_t i = 0; i < readers; ++i) readers_.emplace_back([this] { RunThreads(); });
+    }
+
+    FilePrefetcher::~FilePrefetcher() {
+        {
+            lock_guard<mutex> guard(lock_);
+            stopping_ = true;
+        }
+        slotFreed_.notify_all();
+        fileReady_.notify_all();
+        for (thread& t : readers_) t.join();
+    }
+
+    const char* FilePrefetcher::BackendName() const {
+        return ring_ && !ringFailed_.load(memory_order_relaxed) ? "io_uring" : "threads";
+    }
+
+    bool FilePrefetcher::Next(PrefetchedFile& out) {
+        const Clock::time_point start = Clock::now();
+        unique_lock<mutex> guard(lock_);
+        if (nextHandOut_ == paths_.size()) return false;
+
+        const size_t index = nextHandOut_++;
+        fileReady_.wait(guard, [&] { return loaded_[index].ready || stopping_; });
+        const Loaded& f = loaded_[index];
+        if (!f.ready) return false;
+
+        out.index = index;
+        out.slot = f.slot;
+        out.data = string_view(slots_[f.slot].buffer.data(), f.size);
+        out.error = f.error;
+        out.readSeconds = f.readSeconds;
+        out.waitSeconds = SecondsSince(start);
+        return true;
+    }
+
+    void FilePrefetcher::Release(const PrefetchedFile& file) {
+        {
+            lock_guard<mutex> guard(lock_);
+            slots_[file.slot].free = true;
+        }
+        slotFreed_.notify_one();
+    }
+
+    bool FilePrefetcher::Claim(size_t& index, size_t& slot, bool wait) {
+        unique_lock<mutex> guard(lock_);
+        auto freeSlot = find_if(slots_.begin(), slots_.end(), [](const Slot& s) { return s.free; });
+        while (wait && !stopping_ && nextRead_ < paths_.size() && freeSlot == slots_.end()) {
+            slotFreed_.wait(guard);
+            freeSlot = find_if(slots_.begin(), slots_.end(), [](const Slot& s) { return s.free; });
+        }
+        if (stopping_ || nextRead_ == paths_.size() || freeSlot == slots_.end()) return false;
+
+        freeSlot->free = false;
+        index = nextRead_++;
+        slot = static_cast<size_t>(freeSlot - slots_.begin());
+        return true;
+    }
+
+    void FilePrefetcher::Publish(size_t index, size_t slot, size_t size, string error, double readSeconds) {
+        {
+            lock_guard<mutex> guard(lock_);
+            Loaded& f = loaded_[index];
+            f.slot = slot;
+            f.size = size;
+            f.error = move(error);
+            f.readSeconds = readSeconds;
+            f.ready = true;
+        }
+        fileReady_.notify_all();
+    }
+
+    void FilePrefetcher::RunThreads() {
+        size_t index, slot;
+        while (Claim(index, slot, true)) {
+            const Clock::time_point start = Clock::now();
+            string& buffer = slots_[slot].buffer;
+            size_t size = 0;
+            string error;
+
+            int fd = OpenForRead(paths_[index]);
+            if (fd < 0) error = strerror(errno);
+            else {
+                ReadWhole(fd, buffer, size, error);
+                CloseFd(fd);
+            }
+            Publish(index, slot, size, move(error), SecondsSince(start));
+        }
+    }
+
+#ifdef CLEX_HAVE_IO_URING
+    // Opens and sizes files itself, then keeps up to one read per slot in flight,
+    // re-queueing the remainder after short reads.
+    void FilePrefetcher::RunRing() {
+        struct Read {
+            int               fd = -1;
+            size_t            index = 0;
+            size_t            size = 0;
+            size_t            done = 0;
+            Clock::time_point start;
+        };
+        vector<Read> reads(slots_.size());
+        size_t inFlight = 0;
+
+        auto finish = [&](size_t slot, string error) {
+            Read& r = reads[slot];
+            CloseFd(r.fd);
+            r.fd = -1;
+            --inFlight;
+            Publish(r.index, slot, r.done, move(error), SecondsSince(r.start));
+        };
+
+        while (true) {
+            size_t index, slot;
+            while (Claim(index, slot, inFlight == 0)) {
+                Read& r = reads[slot];
+                r = Read{ OpenForRead(paths_[index]), index, 0, 0, Clock::now() };
+                string& buffer = slots_[slot].buffer;
+                if (r.fd < 0) {
+                    string error = strerror(errno);
+                    Publish(index, slot, 0, move(error), SecondsSince(r.start));
+                    continue;
+                }
+                if (!RegularSize(r.fd, r.size)) {
+                    string error;
+                    ReadWhole(r.fd, buffer, r.done, error);
+                    CloseFd(r.fd);
+                    r.fd = -1;
+                    Publish(index, slot, r.done, move(error), SecondsSince(r.start));
+                    continue;
+                }
+
+                buffer.resize(r.size);
+                if (r.size == 0) {
+                    CloseFd(r.fd);
+                    r.fd = -1;
+                    Publish(index, slot, 0, string(), SecondsSince(r.start));
+                    continue;
+                }
+                ring_->QueueRead(r.fd, &buffer[0], r.size, 0, slot);
+                ++inFlight;
+            }
+            if (inFlight == 0) {
+                lock_guard<mutex> guard(lock_);
+                if (stopping_ || nextRead_ == paths_.size()) return;
+                continue;
+            }
+
+            if (!ring_->SubmitAndWait()) {
+                // The ring broke under us, so nothing queued will complete: read
+                // the files in flight directly and leave the rest to pread readers.
+                ringFailed_.store(true, memory_order_relaxed);
+                for (size_t s = 0; s < reads.size(); ++s) {
+                    Read& r = reads[s];
+                    if (r.fd < 0) continue;
+                    string error;
+                    ReadWhole(r.fd, slots_[s].buffer, r.done, error);
+                    finish(s, move(error));
+                }
+
+                vector<thread> helpers;
+                for (size_t i = 1; i < min(slots_.size(), kMaxReaderThreads); ++i) helpers.emplace_back([this] { RunThreads(); });
+                RunThreads();
+                for (thread& t : helpers) t.join();
+                return;
+            }
+
+            uint64_t tag;
+            int result;
+            while (ring_->Reap(tag, result)) {
+                Read& r = reads[tag];
+                if (result == -EINTR || result == -EAGAIN) {
+                    ring_->QueueRead(r.fd, &slots_[tag].buffer[r.done], r.size - r.done, r.done, tag);
+                    continue;
+                }
+                if (result < 0) { finish(tag, strerror(-result)); continue; }
+
+                r.done += static_cast<size_t>(result);
+                if (result == 0 || r.done == r.size) finish(tag, string());   // 0: the file shrank
+                else ring_->QueueRead(r.fd, &slots_[tag].buffer[r.done], r.size - r.done, r.done, tag);
+            }
+        }
+    }
+#else
+    void FilePrefetcher::RunRing() {}
+#endif
+
+}
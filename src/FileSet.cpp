@@ -0,0 +1,111 @@
+#include "lexer/FileSet.hpp"
+#include <algorithm>
+#include <filesystem>
+#include <fstream>
+using namespace std;
+namespace fs = std::filesystem;
+
+namespace clex {
+
+    namespace {
+
+        bool IsSourceFile(const fs::path& p) {
+            string ext = p.extension().string();
+            return ext == ".c" || ext == ".h";
+        }
+
+        bool HasWildcard(string_view s) {
+            return s.find_first_of("*?") != string_view::npos;
+        }
+
+        void CollectDirectory(const fs::path& dir, const string& pattern, vector<string>& out) {
+            vector<string> found;
+            error_code ec;
+            for (fs::recursive_directory_iterator it(dir, fs::directory_options::skip_permission_denied, ec), end;
+                !ec && it != end; it.increment(ec)) {
+                if (!it->is_regular_file(ec)) continue;
+
+                const fs::path& p = it->path();
+                if (pattern.empty() ? IsSourceFile(p) : MatchGlob(pattern, p.generic_string())) {
+                    found.push_back(p.generic_string());
+                }
+            }
+
+            sort(found.begin(), found.end());
+            out.insert(out.end(), found.begin(), found.end());
+        }
+
+        bool Expand(const string& input, vector<string>& out, string& error, int depth) {
+            if (input.size() > 1 && input[0] == '@') {
+                if (depth > 8) { error = "Response files nested too deeply: " + input; return false; }
+
+                ifstream list(input.substr(1));
+                if (!list) { error = "Cannot open response file: " + input.substr(1); return false; }
+
+                string line;
+                while (getline(list, line)) {
+                    size_t b = line.find_first_not_of(" \t\r");
+                    size_t e = line.find_last_not_of(" \t\r");
+                    if (b == string::npos || line[b] == '#') continue;
+                    if (!Expand(line.substr(b, e - b + 1), out, error, depth + 1)) return false;
+                }
+                return true;
+            }
+
+            if (HasWildcard(input)) {
+                string pattern = fs::path(input).generic_string();
+                size_t wild = pattern.find_first_of("*?");
+                size_t slash = pattern.rfind('/', wild);
+                fs::path base = slash == string::npos ? fs::path(".") : fs::path(pattern.substr(0, slash + 1));
+
+                if (slash == string::npos) pattern = "./" + pattern;
+                CollectDirectory(base, pattern, out);
+                return true;
+            }
+
+            error_code ec;
+            if (fs::is_directory(input, ec)) {
+                CollectDirectory(input, {}, out);
+                return true;
+            }
+
+            out.push_back(input);
+            return true;
+        }
+
+    }
+
+    bool MatchGlob(string_view pattern, string_view path) {
+        if (pattern.empty()) return path.empty();
+
+        if (pattern.substr(0, 2) == "**") {
+            string_view rest = pattern.substr(2);
+            if (!rest.empty() && rest[0] == '/') rest.remove_prefix(1);
+            for (size_t i = 0; i <= path.size(); ++i) {
+                if ((i == 0 || path[i - 1] == '/') && MatchGlob(rest, path.substr(i))) return true;
+            }
+            return false;
+        }
+
+        if (pattern[0] == '*') {
+            for (size_t i = 0; i <= path.size(); ++i) {
+                if (MatchGlob(pattern.substr(1), path.substr(i))) return true;
+                if (i < path.size() && path[i] == '/') break;
+            }
+            return false;
+        }
+
+        if (path.empty()) return false;
+        if (pattern[0] == '?' ? path[0] == '/' : pattern[0] != path[0]) return false;
+        return MatchGlob(pattern.substr(1), path.substr(1));
+    }
+
+    vector<string> ExpandInputs(const vector<string>& inputs, string& error) {
+        vector<string> out;
+        for (const string& input : inputs) {
+            if (!Expand(input, out, error, 0)) return {};
+        }
+        return out;
+    }
+
+}
@@ -0,0 +1,84 @@
+#include "lexer/Hash.hpp"
+#include <cstring>
+using namespace std;
+
+namespace clex {
+
+    namespace {
+
+        constexpr uint64_t kPrime1 = 0x9E3779B185EBCA87ull;
+        constexpr uint64_t kPrime2 = 0xC2B2AE3D27D4EB4Full;
+        constexpr uint64_t kPrime3 = 0x165667B19E3779F9ull;
+        constexpr uint64_t kPrime4 = 0x85EBCA77C2B2AE63ull;
+        constexpr uint64_t kPrime5 = 0x27D4EB2F165667C5ull;
+
+        uint64_t Rotl(uint64_t x, int r) { return (x << r) | (x >> (64 - r)); }
+
+        uint64_t Read64(const char* p) { uint64_t v; memcpy(&v, p, sizeof(v)); return v; }
+        uint32_t Read32(const char* p) { uint32_t v; memcpy(&v, p, sizeof(v)); return v; }
+
+        uint64_t Round(uint64_t acc, uint64_t input) {
+            acc += input * kPrime2;
+            return Rotl(acc, 31) * kPrime1;
+        }
+
+        uint64_t MergeRound(uint64_t acc, uint64_t value) {
+            acc ^= Round(0, value);
+            return acc * kPrime1 + kPrime4;
+        }
+
+    }
+
+    uint64_t HashBytes(string_view bytes, uint64_t seed) {
+        const char* p = bytes.data();
+        const char* end = p + bytes.size();
+        uint64_t h;
+
+        if (bytes.size() >= 32) {
+            uint64_t v1 = seed + kPrime1 + kPrime2;
+            uint64_t v2 = seed + kPrime2;
+            uint64_t v3 = seed;
+            uint64_t v4 = seed - kPrime1;
+
+            for (; end - p >= 32; p += 32) {
+                v1 = Round(v1, Read64(p));
+                v2 = Round(v2, Read64(p + 8));
+                v3 = Round(v3, Read64(p + 16));
+                v4 = Round(v4, Read64(p + 24));
+            }
+
+            h = Rotl(v1, 1) + Rotl(v2, 7) + Rotl(v3, 12) + Rotl(v4, 18);
+            h = MergeRound(h, v1);
+            h = MergeRound(h, v2);
+            h = MergeRound(h, v3);
+            h = MergeRound(h, v4);
+        }
+        else {
+            h = seed + kPrime5;
+        }
+
+        h += bytes.size();
+
+        for (; end - p >= 8; p += 8) {
+            h ^= Round(0, Read64(p));
+            h = Rotl(h, 27) * kPrime1 + kPrime4;
+        }
+        if (end - p >= 4) {
+            h ^= static_cast<uint64_t>(Read32(p)) * kPrime1;
+            h = Rotl(h, 23) * kPrime2 + kPrime3;
+            p += 4;
+        }
+        for (; p < end; ++p) {
+            h ^= static_cast<unsigned char>(*p) * kPrime5;
+            h = Rotl(h, 11) * kPrime1;
+        }
+
+        h ^= h >> 33;
+        h *= kPrime2;
+        h ^= h >> 29;
+        h *= kPrime3;
+        h ^= h >> 32;
+        return h;
+    }
+
+}
@@ -0,0 +1,213 @@
+#include "lexer/Lexer.hpp"
+#include "lexer/SymbolTable.hpp"
+#include "lexer/Utf8.hpp"
+#include <algorithm>
+using namespace std;
+
+namespace clex {
+
+    namespace {
+
+        // No token decision looks further than 3 bytes past the token's end
+        // ("1e+x" has to see the 'x' to settle on IntLiteral "1").
+        constexpr size_t kLookahead = 4;
+
+    }
+
+    void Lexer::Relex(CompactTokenStream& stream, const TextEdit& edit) {
+        if (RejectOversized(stream)) return;
+
+        vector<CompactToken>& old = stream.tokens;
+        const size_t editEndOld = edit.offset + edit.removedLength;
+        const size_t editEndNew = edit.offset + edit.insertedLength;
+        const int64_t delta = static_cast<int64_t>(edit.insertedLength) - static_cast<int64_t>(edit.removedLength);
+
+        // First token whose bytes (plus lookahead) reach the edit. An unterminated
+        // string or char literal scanned to EOF before failing, so a trailing
+        // Error token is never reused.
+        size_t r = static_cast<size_t>(lower_bound(old.begin(), old.end(), edit.offset,
+            [](const CompactToken& t, size_t o) { return t.offset + t.length + kLookahead <= o; }) - old.begin());
+        if (!old.empty() && old.back().Kind() == TokenKind::Error) r = min(r, old.size() - 1);
+
+        // When recovering, errors sit mid-stream too, and an unterminated string
+        // may have failed only because no closing quote followed up to EOF.
+        if (options_.recoverFromErrors) {
+            for (const TokenDiagnostic& d : stream.diagnostics) {
+                if (d.token >= r) break;
+                if (source_[old[d.token].offset] == '"') {
+                    r = d.token;
+                    break;
+                }
+            }
+        }
+
+        const size_t bom = Utf8BomLength(source_);
+        size_t restart = bom;
+        SourcePos restartPos{ 1, 1 };
+        if (r < old.size() && old[r].offset <= edit.offset) {
+            restart = old[r].offset;
+            restartPos = old[r].Pos();
+        }
+        else if (r > 0) {
+            restart = old[r - 1].offset + old[r - 1].length;
+            restartPos = TokenEndPosition(source_, old[r - 1], options_.codePointColumns);
+        }
+        // An edit may have just inserted a BOM in front of the first token.
+        if (restart < bom) {
+            restart = bom;
+            restartPos = { 1, 1 };
+        }
+
+        // Re-lex until a token starts where an old token, shifted by the edit, started.
+        vector<CompactToken> fresh;
+        vector<TokenDiagnostic> freshDiagnostics;
+        size_t m = r;
+        bool resynced = false;
+        const size_t errorsBefore = static_cast<size_t>(count_if(stream.diagnostics.begin(), stream.diagnostics.end(),
+            [r](const TokenDiagnostic& d) { return d.token < r; }));
+
+        Seek(restart, restartPos);
+        RawToken raw;
+        while (true) {
+            if (!NextRawToken(raw)) {
+                fresh.push_back(MakeCompactToken(TokenKind::EndOfFile, index_, 0, CursorPos()));
+                break;
+            }
+
+            if (raw.offset >= editEndNew) {
+                size_t oldOffset = static_cast<size_t>(static_cast<int64_t>(raw.offset) - delta);
+                while (m < old.size() && old[m].offset < oldOffset) ++m;
+                if (m < old.size() && old[m].offset == oldOffset && oldOffset >= editEndOld) {
+                    resynced = true;
+                    break;
+                }
+            }
+
+            fresh.push_back(MakeCompactToken(raw.kind, raw.offset, raw.length, raw.pos));
+            if (raw.kind == TokenKind::Error) {
+                freshDiagnostics.push_back({ static_cast<uint32_t>(fresh.size() - 1), raw.message });
+                if (options_.StopAfter(errorsBefore + freshDiagnostics.size())) break;
+            }
+        }
+
+        vector<TokenDiagnostic> diagnostics;
+        for (const TokenDiagnostic& d : stream.diagnostics) {
+            if (d.token < r) diagnostics.push_back(d);
+        }
+        for (TokenDiagnostic d : freshDiagnostics) {
+            d.token += static_cast<uint32_t>(r);
+            diagnostics.push_back(d);
+        }
+
+        // Symbols are spliced like the tokens when the stream already has them;
+        // otherwise the whole stream is interned once it is up to date.
+        const bool spliceSymbols = options_.symbols && stream.symbols.size() == old.size();
+        vector<uint32_t> freshSymbols;
+        if (spliceSymbols) {
+            for (const CompactToken& t : fresh) {
+                freshSymbols.push_back(t.Kind() == TokenKind::Identifier
+                    ? options_.symbols->Intern(source_.substr(t.offset, t.length)) : kNoSymbol);
+            }
+        }
+
+        if (!resynced) {
+            old.resize(r);
+            old.insert(old.end(), fresh.begin(), fresh.end());
+            if (spliceSymbols) {
+                stream.symbols.resize(r);
+                stream.symbols.insert(stream.symbols.end(), freshSymbols.begin(), freshSymbols.end());
+            }
+            FinishRelex(stream, move(diagnostics), spliceSymbols);
+            return;
+        }
+
+        // Tokens from m on are unchanged except for their offsets and positions;
+        // columns only move for the tokens that share the resync token's line.
+        const uint32_t anchorLine = old[m].line;
+        const int64_t lineDelta = static_cast<int64_t>(raw.pos.line) - anchorLine;
+        const int64_t columnDelta = static_cast<int64_t>(raw.pos.column) - old[m].column;
+        const size_t tailIndex = r + fresh.size();
+
+        for (const TokenDiagnostic& d : stream.diagnostics) {
+            if (d.token >= m) diagnostics.push_back({ static_cast<uint32_t>(d.token - m + tailIndex), d.message });
+        }
+
+        old.erase(old.begin() + r, old.begin() + m);
+        old.insert(old.begin() + r, fresh.begin(), fresh.end());
+        if (spliceSymbols) {
+            stream.symbols.erase(stream.symbols.begin() + r, stream.symbols.begin() + m);
+            stream.symbols.insert(stream.symbols.begin() + r, freshSymbols.begin(), freshSymbols.end());
+        }
+
+        const bool track = options_.trackPositions;
+        for (size_t i = tailIndex; i < old.size(); ++i) {
+            CompactToken& t = old[i];
+            if (track) {
+                if (t.line == anchorLine) t.column = static_cast<uint32_t>(t.column + columnDelta);
+                t.line = static_cast<uint32_t>(t.line + lineDelta);
+            }
+            t.offset = static_cast<uint32_t>(t.offset + delta);
+        }
+
+        // Untracked streams only position their errors; look the shifted ones up again.
+        if (!track) {
+            for (const TokenDiagnostic& d : diagnostics) {
+                if (d.token < tailIndex) continue;
+                CompactToken& t = old[d.token];
+                t = MakeCompactToken(t.Kind(), t.offset, t.length, ErrorPosition(t.offset));
+            }
+        }
+
+        if (options_.recoverFromErrors) SettleErrorCap(stream, diagnostics, spliceSymbols);
+        FinishRelex(stream, move(diagnostics), spliceSymbols);
+    }
+
+    // The spliced stream may now reach the cap before its end, or may end at an
+    // error that capped the old stream but no longer reaches the cap.
+    void Lexer::SettleErrorCap(CompactTokenStream& stream, vector<TokenDiagnostic>& diagnostics, bool symbolsSpliced) {
+        vector<CompactToken>& tokens = stream.tokens;
+        const size_t cap = options_.maxErrors;
+
+        if (cap != 0 && diagnostics.size() >= cap) {
+            const size_t keep = diagnostics[cap - 1].token + 1;
+            diagnostics.resize(cap);
+            tokens.resize(keep);
+            if (symbolsSpliced) stream.symbols.resize(keep);
+            return;
+        }
+
+        if (tokens.empty() || tokens.back().Kind() == TokenKind::EndOfFile || options_.StopAfter(diagnostics.size())) return;
+
+        const CompactToken last = tokens.back();
+        Seek(last.offset + last.length, TokenEndPosition(source_, last, options_.codePointColumns));
+
+        RawToken raw;
+        while (NextRawToken(raw)) {
+            tokens.push_back(MakeCompactToken(raw.kind, raw.offset, raw.length, raw.pos));
+            if (symbolsSpliced) {
+                stream.symbols.push_back(raw.kind == TokenKind::Identifier
+                    ? options_.symbols->Intern(source_.substr(raw.offset, raw.length)) : kNoSymbol);
+            }
+
+            if (raw.kind == TokenKind::Error) {
+                diagnostics.push_back({ static_cast<uint32_t>(tokens.size() - 1), raw.message });
+                if (options_.StopAfter(diagnostics.size())) return;
+            }
+        }
+
+        tokens.push_back(MakeCompactToken(TokenKind::EndOfFile, index_, 0, CursorPos()));
+        if (symbolsSpliced) stream.symbols.push_back(kNoSymbol);
+    }
+
+    void Lexer::FinishRelex(CompactTokenStream& stream, vector<TokenDiagnostic> diagnostics, bool symbolsSpliced) {
+        stream.diagnostics = move(diagnostics);
+        stream.source = source_;
+
+        if (!options_.symbols) stream.symbols.clear();
+        else if (!symbolsSpliced) {
+            stream.symbols.clear();
+            InternIdentifiers(stream, *options_.symbols);
+        }
+    }
+
+}
@@ -0,0 +1,472 @@
+#include "lexer/IndexFile.hpp"
+#include "lexer/Hash.hpp"
+#include "lexer/Lexer.hpp"
+#include "lexer/SymbolTable.hpp"
+#include "lexer/ThreadPool.hpp"
+#include <algorithm>
+#include <atomic>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <memory>
+#include <unordered_map>
+#ifdef _WIN32
+#include <process.h>
+#define getpid _getpid
+#else
+#include <unistd.h>
+#endif
+using namespace std;
+namespace fs = std::filesystem;
+
+namespace clex {
+
+    namespace {
+
+        constexpr uint32_t kNoFile = 0xFFFFFFFFu;
+
+        template <class T>
+        void Append(string& out, const T& value) {
+            out.append(reinterpret_cast<const char*>(&value), sizeof(T));
+        }
+
+        void PutVarint(string& out, uint32_t value) {
+            while (value >= 0x80) {
+                out += static_cast<char>(value | 0x80);
+                value >>= 7;
+            }
+            out += static_cast<char>(value);
+        }
+
+        bool GetVarint(const char*& p, const char* end, uint32_t& value) {
+            uint64_t v = 0;
+            for (unsigned shift = 0; shift < 35 && p < end; shift += 7) {
+                const uint8_t byte = static_cast<uint8_t>(*p++);
+                v |= static_cast<uint64_t>(byte & 0x7F) << shift;
+                if (!(byte & 0x80)) {
+                    if (v > UINT32_MAX) return false;
+                    value = static_cast<uint32_t>(v);
+                    return true;
+                }
+            }
+            return false;
+        }
+
+        bool IsIncludeName(string_view name) {
+            return name == "include" || name == "include_next" || name == "import";
+        }
+
+        // The lexer keeps a whole preprocessor line as one Preprocessor token, so
+        // its names are found by lexing the line again without the '#': the
+        // directive name and every identifier or keyword of the body, e.g. BSIZE
+        // in "#define BSIZE 8192" or X in "#if defined(X)". A '#' inside the body
+        // (stringizing) begins a Preprocessor token of its own, lexed the same
+        // way. Header names such as <stdio.h> are skipped.
+        template <class Add>
+        void ForEachDirectiveName(string_view lexeme, const CompactToken& directive, Add add) {
+            struct Line {
+                string_view text;
+                uint32_t    offset;
+                uint32_t    column;
+            };
+            vector<Line> pending { { lexeme.substr(1), directive.offset + 1, static_cast<uint32_t>(directive.column) + 1 } };
+            bool outermost = true;
+
+            LexerOptions options;
+            options.recoverFromErrors = true;
+            while (!pending.empty()) {
+                const Line line = pending.back();
+                pending.pop_back();
+
+                Lexer lexer(line.text, options);
+                CompactTokenStream stream = lexer.TokenizeAllCompact();
+                bool nameSeen = !outermost;
+                bool headerName = false;
+                for (size_t i = 0; i < stream.tokens.size(); ++i) {
+                    const CompactToken& t = stream.tokens[i];
+                    const string_view text = stream.Lexeme(t);
+                    const uint32_t offset = line.offset + t.offset;
+                    const uint32_t column = line.column + static_cast<uint32_t>(t.column) - 1;
+                    if (t.Kind() == TokenKind::Comment) continue;
+                    if (headerName) {
+                        headerName = text != ">";
+                        continue;
+                    }
+
+                    if (t.Kind() == TokenKind::Preprocessor) pending.push_back({ text.substr(1), offset + 1, column + 1 });
+                    else if (t.Kind() == TokenKind::Identifier || t.Kind() == TokenKind::Keyword) add(text, offset, column);
+
+                    if (!nameSeen) {
+                        nameSeen = true;
+                        headerName = IsIncludeName(text) && i + 1 < stream.tokens.size() && stream.Lexeme(stream.tokens[i + 1]) == "<";
+                    }
+                }
+                outermost = false;
+            }
+        }
+
+        bool ByPosition(const IndexPosting& a, const IndexPosting& b) {
+            return a.file != b.file ? a.file < b.file : a.offset < b.offset;
+        }
+
+        // Postings must be in ByPosition order.
+        void EncodePostings(const vector<IndexPosting>& postings, string& out) {
+            uint32_t file = 0;
+            for (size_t i = 0; i < postings.size();) {
+                size_t end = i;
+                while (end < postings.size() && postings[end].file == postings[i].file) ++end;
+
+                PutVarint(out, postings[i].file - file);
+                PutVarint(out, static_cast<uint32_t>(end - i));
+                file = postings[i].file;
+
+                uint32_t offset = 0, line = 0;
+                for (; i < end; ++i) {
+                    const IndexPosting& p = postings[i];
+                    PutVarint(out, p.offset - offset);
+                    PutVarint(out, p.line - line);
+                    PutVarint(out, p.column);
+                    offset = p.offset;
+                    line = p.line;
+                }
+            }
+        }
+
+        struct Occurrence {
+            uint32_t term;
+            uint32_t offset;
+            uint32_t line;
+            uint32_t column;
+        };
+
+        struct FileResult {
+            indexfile::FileRecord record{};
+            uint32_t              previous = kNoFile;   // file of the old index whose postings are kept
+            vector<Occurrence>    occurrences;
+            bool                  readable = true;
+        };
+
+        atomic<uint64_t> tempCounter{ 0 };
+
+    }
+
+    bool IndexFile::Fail(string message) {
+        error_ = move(message);
+        header_ = {};
+        files_ = nullptr;
+        terms_ = nullptr;
+        return false;
+    }
+
+    bool IndexFile::Open(const string& path) {
+        if (!file_.Open(path)) return Fail(file_.Error());
+        return Load(file_.View());
+    }
+
+    bool IndexFile::Load(string_view bytes) {
+        using namespace indexfile;
+
+        if (bytes.size() < sizeof(Header)) return Fail("truncated header");
+        memcpy(&header_, bytes.data(), sizeof(Header));
+
+        if (memcmp(header_.magic, kMagic, sizeof(kMagic)) != 0) return Fail("not an index file");
+        if (header_.version != kVersion) return Fail("unsupported index version");
+
+        // Records are bounds-checked as they are read, so opening costs the same
+        // however large the index is.
+        size_t left = bytes.size() - sizeof(Header);
+        if (header_.fileCount > left / sizeof(FileRecord)) return Fail("truncated file records");
+        left -= header_.fileCount * sizeof(FileRecord);
+        if (header_.termCount > left / sizeof(TermRecord)) return Fail("truncated term records");
+        left -= header_.termCount * sizeof(TermRecord);
+        if (header_.postingBytes > left) return Fail("truncated postings");
+        left -= header_.postingBytes;
+        if (header_.stringBytes > left) return Fail("truncated strings");
+
+        const char* p = bytes.data() + sizeof(Header);
+        files_ = reinterpret_cast<const FileRecord*>(p);
+        p += header_.fileCount * sizeof(FileRecord);
+        terms_ = reinterpret_cast<const TermRecord*>(p);
+        p += header_.termCount * sizeof(TermRecord);
+        postings_ = string_view(p, static_cast<size_t>(header_.postingBytes));
+        p += header_.postingBytes;
+        strings_ = string_view(p, static_cast<size_t>(header_.stringBytes));
+
+        error_.clear();
+        return true;
+    }
+
+    string_view IndexFile::String(uint32_t offset, uint32_t length) const {
+        if (offset > strings_.size() || length > strings_.size() - offset) return {};
+        return strings_.substr(offset, length);
+    }
+
+    indexfile::FileRecord IndexFile::File(size_t index) const {
+        indexfile::FileRecord r;
+        memcpy(&r, &files_[index], sizeof(r));
+        return r;
+    }
+
+    string_view IndexFile::FilePath(size_t index) const {
+        indexfile::FileRecord r = File(index);
+        return String(r.pathOffset, r.pathLength);
+    }
+
+    indexfile::TermRecord IndexFile::TermAt(size_t index) const {
+        indexfile::TermRecord r;
+        memcpy(&r, &terms_[index], sizeof(r));
+        return r;
+    }
+
+    string_view IndexFile::Term(size_t index) const {
+        indexfile::TermRecord r = TermAt(index);
+        return String(r.nameOffset, r.nameLength);
+    }
+
+    size_t IndexFile::PostingCount(size_t term) const {
+        return TermAt(term).postingCount;
+    }
+
+    size_t IndexFile::LowerBound(string_view prefix) const {
+        size_t lo = 0, hi = TermCount();
+        while (lo < hi) {
+            size_t mid = lo + (hi - lo) / 2;
+            if (Term(mid) < prefix) lo = mid + 1;
+            else hi = mid;
+        }
+        return lo;
+    }
+
+    size_t IndexFile::FindTerm(string_view term) const {
+        size_t i = LowerBound(term);
+        return i < TermCount() && Term(i) == term ? i : TermCount();
+    }
+
+    bool IndexFile::Postings(size_t term, vector<IndexPosting>& out) const {
+        indexfile::TermRecord r = TermAt(term);
+        if (r.postingOffset > postings_.size() || r.postingBytes > postings_.size() - r.postingOffset) return false;
+
+        const char* p = postings_.data() + r.postingOffset;
+        const char* const end = p + r.postingBytes;
+        uint32_t file = 0;
+        while (p < end) {
+            uint32_t delta, count;
+            if (!GetVarint(p, end, delta) || !GetVarint(p, end, count)) return false;
+            file += delta;
+            if (file >= FileCount()) return false;
+
+            IndexPosting posting;
+            posting.file = file;
+            for (uint32_t k = 0; k < count; ++k) {
+                uint32_t offsetDelta, lineDelta;
+                if (!GetVarint(p, end, offsetDelta) || !GetVarint(p, end, lineDelta) || !GetVarint(p, end, posting.column)) return false;
+                posting.offset += offsetDelta;
+                posting.line += lineDelta;
+                out.push_back(posting);
+            }
+        }
+        return true;
+    }
+
+    bool UpdateIndex(const string& indexPath, const vector<string>& files, size_t jobs, IndexUpdate& update, string& error) {
+        update = {};
+
+        // An index built by another lexer version is rebuilt from scratch.
+        auto previous = make_unique<IndexFile>();
+        if (!previous->Open(indexPath) || previous->LexerVersion() != kLexerVersion) previous.reset();
+
+        unordered_map<string_view, uint32_t> previousIds;
+        if (previous) {
+            for (size_t i = 0; i < previous->FileCount(); ++i) previousIds.emplace(previous->FilePath(i), static_cast<uint32_t>(i));
+        }
+
+        SymbolTable terms;
+        vector<FileResult> results(files.size());
+        {
+            ThreadPool pool(jobs);
+            for (size_t i = 0; i < files.size(); ++i) {
+                pool.Submit([&, i] {
+                    const string& path = files[i];
+                    FileResult& r = results[i];
+
+                    auto known = previousIds.find(path);
+                    const bool wasIndexed = known != previousIds.end();
+                    const indexfile::FileRecord old = wasIndexed ? previous->File(known->second) : indexfile::FileRecord{};
+
+                    error_code ec;
+                    const int64_t modified = fs::last_write_time(path, ec).time_since_epoch().count();
+                    const uint64_t size = ec ? 0 : fs::file_size(path, ec);
+                    if (!ec && wasIndexed && old.size == size && old.modified == modified) {
+                        r.record = old;
+                        r.previous = known->second;
+                        return;
+                    }
+
+                    MappedFile file;
+                    if (!file.Open(path)) {
+                        r.readable = false;
+                        return;
+                    }
+
+                    r.record.hash = HashBytes(file.View());
+                    r.record.size = file.View().size();
+                    r.record.modified = ec ? 0 : modified;
+                    if (wasIndexed && old.size == r.record.size && old.hash == r.record.hash) {
+                        r.previous = known->second;
+                        return;
+                    }
+
+                    LexerOptions options;
+                    options.recoverFromErrors = true;
+                    Lexer lexer(file, options);
+                    CompactTokenStream stream = lexer.TokenizeAllCompact();
+                    for (const CompactToken& t : stream.tokens) {
+                        if (t.Kind() == TokenKind::Preprocessor) {
+                            ForEachDirectiveName(stream.Lexeme(t), t, [&](string_view name, uint32_t offset, uint32_t column) {
+                                r.occurrences.push_back({ terms.Intern(name), offset, t.line, column });
+                            });
+                            continue;
+                        }
+                        if (t.Kind() != TokenKind::Identifier && t.Kind() != TokenKind::Keyword) continue;
+                        r.occurrences.push_back({ terms.Intern(stream.Lexeme(t)), t.offset, t.line, t.column });
+                    }
+                });
+            }
+            pool.Wait();
+        }
+
+        // Readable files are numbered in input order.
+        vector<uint32_t> remap(previous ? previous->FileCount() : 0, kNoFile);
+        vector<uint32_t> ids(files.size(), kNoFile);
+        uint32_t fileCount = 0;
+        for (size_t i = 0; i < files.size(); ++i) {
+            if (!results[i].readable) {
+                update.unreadable.push_back(files[i]);
+                continue;
+            }
+            ids[i] = fileCount++;
+            if (results[i].previous != kNoFile) {
+                remap[results[i].previous] = ids[i];
+                ++update.reused;
+            }
+            else {
+                ++update.lexed;
+            }
+        }
+        // A changed file is lexed again rather than removed.
+        vector<bool> listed(remap.size(), false);
+        for (size_t i = 0; i < files.size(); ++i) {
+            auto known = previousIds.find(files[i]);
+            if (known != previousIds.end()) listed[known->second] = true;
+        }
+        update.removed = static_cast<size_t>(count(listed.begin(), listed.end(), false));
+
+        vector<vector<IndexPosting>> lists(terms.Size());
+        auto listOf = [&](uint32_t term) -> vector<IndexPosting>& {
+            if (term >= lists.size()) lists.resize(term + 1);
+            return lists[term];
+        };
+
+        if (previous && update.reused != 0) {
+            vector<IndexPosting> decoded;
+            for (size_t t = 0; t < previous->TermCount(); ++t) {
+                decoded.clear();
+                if (!previous->Postings(t, decoded)) {
+                    error = "corrupt postings in " + indexPath;
+                    return false;
+                }
+
+                uint32_t term = kNoSymbol;
+                for (IndexPosting p : decoded) {
+                    if (remap[p.file] == kNoFile) continue;
+                    if (term == kNoSymbol) term = terms.Intern(previous->Term(t));
+                    p.file = remap[p.file];
+                    listOf(term).push_back(p);
+                }
+            }
+        }
+
+        for (size_t i = 0; i < files.size(); ++i) {
+            for (const Occurrence& o : results[i].occurrences) listOf(o.term).push_back({ ids[i], o.offset, o.line, o.column });
+            results[i].occurrences = {};
+        }
+
+        // Spellings are interned and paths listed before the old index is unmapped.
+        previous.reset();
+
+        vector<uint32_t> order;
+        for (uint32_t term = 0; term < lists.size(); ++term) {
+            if (lists[term].empty()) continue;
+            order.push_back(term);
+            update.postings += lists[term].size();
+            if (!is_sorted(lists[term].begin(), lists[term].end(), ByPosition)) sort(lists[term].begin(), lists[term].end(), ByPosition);
+        }
+        sort(order.begin(), order.end(), [&](uint32_t a, uint32_t b) { return terms.Name(a) < terms.Name(b); });
+        update.terms = order.size();
+
+        string postings, strings;
+        vector<indexfile::TermRecord> termRecords;
+        termRecords.reserve(order.size());
+        for (uint32_t term : order) {
+            string_view name = terms.Name(term);
+            indexfile::TermRecord r{};
+            r.postingOffset = postings.size();
+            r.postingCount = static_cast<uint32_t>(lists[term].size());
+            r.nameOffset = static_cast<uint32_t>(strings.size());
+            r.nameLength = static_cast<uint32_t>(name.size());
+            EncodePostings(lists[term], postings);
+            r.postingBytes = static_cast<uint32_t>(postings.size() - r.postingOffset);
+            strings.append(name);
+            termRecords.push_back(r);
+        }
+
+        vector<indexfile::FileRecord> fileRecords;
+        fileRecords.reserve(fileCount);
+        for (size_t i = 0; i < files.size(); ++i) {
+            if (ids[i] == kNoFile) continue;
+            indexfile::FileRecord r = results[i].record;
+            r.pathOffset = static_cast<uint32_t>(strings.size());
+            r.pathLength = static_cast<uint32_t>(files[i].size());
+            strings.append(files[i]);
+            fileRecords.push_back(r);
+        }
+
+        indexfile::Header header{};
+        memcpy(header.magic, indexfile::kMagic, sizeof(indexfile::kMagic));
+        header.version = indexfile::kVersion;
+        header.lexerVersion = kLexerVersion;
+        header.fileCount = fileRecords.size();
+        header.termCount = termRecords.size();
+        header.postingBytes = postings.size();
+        header.stringBytes = strings.size();
+
+        string blob;
+        blob.reserve(sizeof(header) + fileRecords.size() * sizeof(indexfile::FileRecord)
+            + termRecords.size() * sizeof(indexfile::TermRecord) + postings.size() + strings.size());
+        Append(blob, header);
+        for (const indexfile::FileRecord& r : fileRecords) Append(blob, r);
+        for (const indexfile::TermRecord& r : termRecords) Append(blob, r);
+        blob += postings;
+        blob += strings;
+
+        // Queries running meanwhile keep the old index until the rename.
+        string temp = indexPath + ".tmp-" + std::to_string(getpid()) + "-" + std::to_string(tempCounter++);
+        FILE* out = fopen(temp.c_str(), "wb");
+        if (!out) {
+            error = "Cannot write: " + temp;
+            return false;
+        }
+        bool written = fwrite(blob.data(), 1, blob.size(), out) == blob.size();
+        written = fclose(out) == 0 && written;
+
+        error_code ec;
+        if (written) fs::rename(temp, indexPath, ec);
+        if (!written || ec) {
+            fs::remove(temp, ec);
+            error = "Cannot write: " + indexPath;
+            return false;
+        }
+        return true;
+    }
+
+}
@@ -0,0 +1,300 @@
+#include "lexer/LexServer.hpp"
+#include "lexer/ThreadPool.hpp"
+#include <algorithm>
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+#include <limits>
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+#include <sys/un.h>
+#include <unistd.h>
+#endif
+using namespace std;
+
+namespace clex {
+
+#ifdef _WIN32
+    string DefaultSocketPath() {
+        const char* env = getenv("CLEX_SOCKET");
+        return env && *env ? env : "clexer.sock";
+    }
+
+    LexServer::LexServer(string socketPath, Handler handler, size_t threads)
+        : socketPath_(move(socketPath)), handler_(move(handler)), threads_(threads) {}
+
+    LexServer::~LexServer() = default;
+
+    bool LexServer::Run(string& error) {
+        error = "serving needs Unix domain sockets, which this build does not support";
+        return false;
+    }
+
+    void LexServer::Stop() {}
+
+    void LexServer::Serve(int) {}
+
+    bool CallServer(const string&, const LexRequest&, LexResponse&, string& error) {
+        error = "Unix domain sockets are not supported on this platform";
+        return false;
+    }
+#else
+    namespace {
+
+        constexpr uint32_t kMagic = 0x31584c43;          // "CLX1"
+        constexpr uint32_t kMaxArgs = 4096;
+        constexpr uint64_t kMaxString = uint64_t(1) << 32;
+        constexpr size_t   kReceiveChunk = size_t(1) << 20;    // strings grow as their bytes arrive
+        constexpr int      kReceiveTimeoutSeconds = 30;    // drops clients that stall mid-request
+
+#ifdef MSG_NOSIGNAL
+        constexpr int kSendFlags = MSG_NOSIGNAL;
+#else
+        constexpr int kSendFlags = 0;                       // the server ignores SIGPIPE instead
+#endif
+
+        int Socket() {
+            int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+            if (fd >= 0) fcntl(fd, F_SETFD, FD_CLOEXEC);
+            return fd;
+        }
+
+        template <typename T>
+        void Put(string& out, T value) {
+            out.append(reinterpret_cast<const char*>(&value), sizeof value);
+        }
+
+        void PutString(string& out, const string& s) {
+            Put<uint64_t>(out, s.size());
+            out += s;
+        }
+
+        bool SendAll(int fd, const string& data) {
+            size_t sent = 0;
+            while (sent < data.size()) {
+                ssize_t n = send(fd, data.data() + sent, data.size() - sent, kSendFlags);
+                if (n < 0 && errno == EINTR) continue;
+                if (n <= 0) return false;
+                sent += static_cast<size_t>(n);
+            }
+            return true;
+        }
+
+        bool ReceiveAll(int fd, char* p, size_t size) {
+            while (size) {
+                ssize_t n = recv(fd, p, size, 0);
+                if (n < 0 && errno == EINTR) continue;
+                if (n <= 0) return false;
+                p += n;
+                size -= static_cast<size_t>(n);
+            }
+            return true;
+        }
+
+        template <typename T>
+        bool Get(int fd, T& value) {
+            return ReceiveAll(fd, reinterpret_cast<char*>(&value), sizeof value);
+        }
+
+        // Takes the string's length out of `budget`, so a frame can claim no
+        // more than the budget in all; the string only grows as bytes arrive.
+        bool GetString(int fd, string& s, uint64_t& budget) {
+            uint64_t size;
+            if (!Get(fd, size) || size > kMaxString || size > budget) return false;
+            budget -= size;
+
+            s.clear();
+            while (s.size() < size) {
+                const size_t have = s.size();
+                const size_t chunk = static_cast<size_t>(min<uint64_t>(size - have, kReceiveChunk));
+                s.resize(have + chunk);
+                if (!ReceiveAll(fd, &s[have], chunk)) return false;
+            }
+            return true;
+        }
+
+        bool MakeAddress(const string& path, sockaddr_un& address, string& error) {
+            memset(&address, 0, sizeof address);
+            address.sun_family = AF_UNIX;
+            if (path.empty() || path.size() >= sizeof address.sun_path) {
+                error = path + ": socket path is empty or too long";
+                return false;
+            }
+            memcpy(address.sun_path, path.c_str(), path.size() + 1);
+            return true;
+        }
+
+        int Connect(const string& path, string& error) {
+            sockaddr_un address;
+            if (!MakeAddress(path, address, error)) return -1;
+
+            int fd = Socket();
+            if (fd < 0) { error = strerror(errno); return -1; }
+            if (connect(fd, reinterpret_cast<const sockaddr*>(&address), sizeof address) != 0) {
+                error = path + ": " + strerror(errno);
+                close(fd);
+                return -1;
+            }
+            return fd;
+        }
+
+    }
+
+    string DefaultSocketPath() {
+        if (const char* env = getenv("CLEX_SOCKET"); env && *env) return env;
+        if (const char* runtime = getenv("XDG_RUNTIME_DIR"); runtime && *runtime) return string(runtime) + "/clexer.sock";
+        return "/tmp/clexer-" + std::to_string(getuid()) + ".sock";
+    }
+
+    LexServer::LexServer(string socketPath, Handler handler, size_t threads)
+        : socketPath_(move(socketPath)), handler_(move(handler)), threads_(threads) {
+        int fds[2];
+        if (pipe(fds) == 0) {
+            fcntl(fds[0], F_SETFD, FD_CLOEXEC);
+            fcntl(fds[1], F_SETFD, FD_CLOEXEC);
+            fcntl(fds[1], F_SETFL, O_NONBLOCK);
+            wakeRead_ = fds[0];
+            wakeWrite_ = fds[1];
+        }
+    }
+
+    LexServer::~LexServer() {
+        if (wakeRead_ >= 0) close(wakeRead_);
+        if (wakeWrite_ >= 0) close(wakeWrite_);
+    }
+
+    void LexServer::Stop() {
+        if (wakeWrite_ >= 0) {
+            ssize_t ignored = write(wakeWrite_, "", 1);
+            (void)ignored;
+        }
+    }
+
+    bool LexServer::Run(string& error) {
+        sockaddr_un address;
+        if (!MakeAddress(socketPath_, address, error)) return false;
+        if (wakeRead_ < 0) { error = "cannot create the stop pipe"; return false; }
+
+        // A path nobody answers on is a leftover from a server that died.
+        string ignored;
+        if (int probe = Connect(socketPath_, ignored); probe >= 0) {
+            close(probe);
+            error = socketPath_ + ": a server is already listening";
+            return false;
+        }
+        struct stat st {};
+        if (lstat(socketPath_.c_str(), &st) == 0 && S_ISSOCK(st.st_mode)) unlink(socketPath_.c_str());
+
+        int listener = Socket();
+        if (listener < 0) { error = strerror(errno); return false; }
+
+        const mode_t mask = umask(0077);   // only the owner may connect
+        const bool bound = bind(listener, reinterpret_cast<const sockaddr*>(&address), sizeof address) == 0;
+        umask(mask);
+        if (!bound || listen(listener, SOMAXCONN) != 0) {
+            error = socketPath_ + ": " + strerror(errno);
+            close(listener);
+            return false;
+        }
+
+        {
+            ThreadPool pool(threads_);
+            pollfd fds[2] = { { listener, POLLIN, 0 }, { wakeRead_, POLLIN, 0 } };
+            while (true) {
+                if (poll(fds, 2, -1) < 0) {
+                    if (errno == EINTR) continue;
+                    error = strerror(errno);
+                    break;
+                }
+                if (fds[1].revents) {
+                    char drained;
+                    ssize_t ignored = read(wakeRead_, &drained, 1);
+                    (void)ignored;
+                    break;
+                }
+                if (!(fds[0].revents & POLLIN)) continue;
+
+                int connection = accept(listener, nullptr, nullptr);
+                if (connection < 0) continue;   // the client gave up, or we are out of descriptors for now
+                fcntl(connection, F_SETFD, FD_CLOEXEC);
+                pool.Submit([this, connection] { Serve(connection); });
+            }
+            pool.Wait();
+        }
+
+        close(listener);
+        unlink(socketPath_.c_str());
+        return error.empty();
+    }
+
+    void LexServer::Serve(int connection) {
+        timeval timeout {};
+        timeout.tv_sec = kReceiveTimeoutSeconds;
+        setsockopt(connection, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof timeout);
+
+        LexRequest request;
+        uint32_t magic, count;
+        uint8_t hasInput;
+        uint64_t budget = LexServer::kMaxRequestBytes;
+        bool ok = Get(connection, magic) && magic == kMagic && Get(connection, count) && count <= kMaxArgs &&
+            GetString(connection, request.directory, budget);
+        request.args.resize(ok ? count : 0);
+        for (string& arg : request.args) ok = ok && GetString(connection, arg, budget);
+        ok = ok && Get(connection, hasInput) && GetString(connection, request.input, budget);
+
+        if (ok) {
+            request.hasInput = hasInput != 0;
+            LexResponse response;
+            handler_(request, response);
+
+            string reply;
+            Put(reply, kMagic);
+            Put<int32_t>(reply, response.exitCode);
+            PutString(reply, response.out);
+            PutString(reply, response.err);
+            SendAll(connection, reply);
+            served_.fetch_add(1, memory_order_relaxed);
+        }
+        close(connection);
+    }
+
+    bool CallServer(const string& socketPath, const LexRequest& request, LexResponse& response, string& error) {
+        uint64_t requestBytes = request.directory.size() + request.input.size();
+        for (const string& arg : request.args) requestBytes += arg.size();
+        if (request.args.size() > kMaxArgs || requestBytes > LexServer::kMaxRequestBytes) {
+            error = "the request is larger than the server accepts";
+            return false;
+        }
+
+        int fd = Connect(socketPath, error);
+        if (fd < 0) return false;
+
+        string message;
+        Put(message, kMagic);
+        Put<uint32_t>(message, static_cast<uint32_t>(request.args.size()));
+        PutString(message, request.directory);
+        for (const string& arg : request.args) PutString(message, arg);
+        Put<uint8_t>(message, request.hasInput);
+        PutString(message, request.input);
+
+        uint32_t magic;
+        int32_t exitCode;
+        uint64_t budget = numeric_limits<uint64_t>::max();   // the server is trusted with its own answer
+        const bool ok = SendAll(fd, message) && Get(fd, magic) && magic == kMagic && Get(fd, exitCode) &&
+            GetString(fd, response.out, budget) && GetString(fd, response.err, budget);
+        close(fd);
+        if (!ok) {
+            error = socketPath + ": the server closed the connection";
+            return false;
+        }
+        response.exitCode = exitCode;
+        return true;
+    }
+#endif
+
+}
@@ -1,20 +1,17 @@
 ﻿#include "lexer/Lexer.hpp"
+#include "lexer/BasicLexer.hpp"
+#include "lexer/MappedFile.hpp"
+#include "lexer/SymbolTable.hpp"
+#include "lexer/TokenRange.hpp"
+#include "lexer/Utf8.hpp"
+#include "lexer/detail/SimdScan.hpp"
 #include <regex>
-#include <unordered_set>
-#include <cctype>
 using namespace std;
 
 namespace clex {
 
     namespace {
 
-        const unordered_set<string> kKeywords = {
-          "int","char","float","double","void","if","else","for","while","return",
-          "const","static","struct","union","enum","typedef","sizeof",
-          "switch","case","default","break","continue","do","goto",
-          "volatile","extern","signed","unsigned","short","long","auto","_Bool"
-        };
-
         const regex RX_WS(R"(^[ \t\r\n]+)");
         const regex RX_PREPROC(R"(^#[^\n]*(\\\n[^\n]*)*)");
 
@@ -49,18 +46,59 @@ namespace clex {
 
     } 
 
-    Lexer::Lexer(string sourceText): sourceText_(move(sourceText)) {}
+    Lexer::Lexer(string sourceText, LexerOptions options)
+        : ownedSource_(make_shared<const string>(move(sourceText))),
+          source_(*ownedSource_),
+          options_(options),
+          index_(Utf8BomLength(source_)) {}
+
+    Lexer::Lexer(const char* sourceText, LexerOptions options)
+        : Lexer(string(sourceText), options) {}
+
+    Lexer::Lexer(string_view sourceView, LexerOptions options)
+        : source_(sourceView), options_(options), index_(Utf8BomLength(source_)) {}
+
+    Lexer::Lexer(const MappedFile& file, LexerOptions options)
+        : Lexer(file.View(), options) {}
+
+    void Lexer::Seek(size_t offset, SourcePos pos) {
+        index_ = offset;
+        line_ = pos.line;
+        column_ = pos.column;
+        batchDone_ = false;
+        batchErrors_ = 0;
+    }
 
     bool Lexer::IsEndOfInput() const { 
-        return index_ >= sourceText_.size(); 
+        return index_ >= source_.size(); 
+    }
+
+    const LineIndex& Lexer::Lines() const {
+        if (!lines_) lines_ = make_shared<const LineIndex>(source_);
+        return *lines_;
+    }
+
+    const LexerStats& Lexer::Stats() const {
+#ifdef CLEX_STATS
+        return stats_;
+#else
+        static const LexerStats empty;
+        return empty;
+#endif
+    }
+
+    SourcePos Lexer::CursorPos() const {
+        return options_.trackPositions ? SourcePos{ line_, column_ } : SourcePos{ 0, 0 };
+    }
+
+    // Errors are positioned through Lines() when nothing else is tracked.
+    SourcePos Lexer::ErrorPosition(size_t offset) const {
+        return options_.codePointColumns ? Lines().CodePointPositionOf(source_, offset) : Lines().PositionOf(offset);
     }
 
     void Lexer::AdvanceCursor(string_view matchedLexeme) {
-        for (char c : matchedLexeme) {
-            ++index_;
-            if (c == '\n') { ++line_; column_ = 1; }
-            else { ++column_; }
-        }
+        if (options_.codePointColumns) detail::Advance<true>(simd::Active(), matchedLexeme, index_, line_, column_);
+        else detail::Advance(simd::Active(), matchedLexeme, index_, line_, column_);
     }
 
     Token Lexer::MakeToken(TokenKind kind,
@@ -71,129 +109,347 @@ namespace clex {
         return Token{ kind, string(lexeme), { lineAtStart, columnAtStart }, move(message) };
     }
 
-    Token Lexer::GetNextToken() {
+    bool Lexer::ScanWithRegex(RawToken& out) {
         while (!IsEndOfInput()) {
-            string_view sv = string_view(sourceText_).substr(index_);
+            string_view sv = source_.substr(index_);
             int L = line_, C = column_;
+            size_t start = index_;
             string m;
 
-            if (MatchAtBegin(sv, RX_WS, m)) { AdvanceCursor(m); continue; }
+            auto emit = [&](TokenKind kind, string_view lexeme, const char* message = nullptr) {
+                AdvanceCursor(lexeme);
+                out = RawToken{ kind, start, lexeme.size(), options_.trackPositions ? SourcePos{ L, C } : SourcePos{ 0, 0 }, message };
+                return true;
+            };
+
+            auto match = [&](LexRule rule, const regex& re) {
+                RuleProbe probe(StatsSink());
+                bool matched = MatchAtBegin(sv, re, m);
+                probe.Record(rule, matched, m.size());
+                return matched;
+            };
 
-            if (MatchAtBegin(sv, RX_PREPROC, m)) { 
-                AdvanceCursor(m); 
-                return MakeToken(TokenKind::Preprocessor, m, L, C); 
-            }
+            if (match(LexRule::Whitespace, RX_WS)) { AdvanceCursor(m); continue; }
 
-            if (MatchAtBegin(sv, RX_LINE_COM, m)) { 
-                AdvanceCursor(m); 
-                return MakeToken(TokenKind::Comment, m, L, C); 
-            }
+            if (match(LexRule::Preprocessor, RX_PREPROC)) return emit(TokenKind::Preprocessor, m);
 
-            if (MatchAtBegin(sv, RX_BLOCK_COM, m)) { 
-                AdvanceCursor(m); 
-                return MakeToken(TokenKind::Comment, m, L, C); 
-            }
+            if (match(LexRule::LineComment, RX_LINE_COM)) return emit(TokenKind::Comment, m);
+
+            if (match(LexRule::BlockComment, RX_BLOCK_COM)) return emit(TokenKind::Comment, m);
 
             if (sv.rfind("/*", 0) == 0) { // unterminated block comment
-                AdvanceCursor(sv);
-                return MakeToken(TokenKind::Error, sv, L, C, "Unterminated block comment");
+                return emit(TokenKind::Error, sv, "Unterminated block comment");
             }
 
             if (!sv.empty() && sv[0] == '"') {
-                if (MatchAtBegin(sv, RX_STRING, m)) { 
-                    AdvanceCursor(m); 
-                    return MakeToken(TokenKind::StringLiteral, m, L, C); 
-                }
+                if (match(LexRule::StringLiteral, RX_STRING)) return emit(TokenKind::StringLiteral, m);
 
                 size_t len = 1; 
                 while (len < sv.size() && sv[len] != '\n') ++len;
 
-                string_view bad = sv.substr(0, len); 
-                AdvanceCursor(bad);
-
-                return MakeToken(TokenKind::Error, bad, L, C, "Unterminated string");
+                return emit(TokenKind::Error, sv.substr(0, len), "Unterminated string");
             }
             if (!sv.empty() && sv[0] == '\'') {
-                if (MatchAtBegin(sv, RX_CHAR, m)) { 
-                    AdvanceCursor(m); 
-                    return MakeToken(TokenKind::CharLiteral, m, L, C); 
-                }
+                if (match(LexRule::CharLiteral, RX_CHAR)) return emit(TokenKind::CharLiteral, m);
 
                 size_t len = 1; 
                 while (len < sv.size() && sv[len] != '\n') ++len;
 
-                string_view bad = sv.substr(0, len); 
-                AdvanceCursor(bad);
-
-                return MakeToken(TokenKind::Error, bad, L, C, "Unterminated char literal");
+                return emit(TokenKind::Error, sv.substr(0, len), "Unterminated char literal");
             }
 
-            if (MatchAtBegin(sv, RX_INT_HEX, m)) { 
-                AdvanceCursor(m); 
-                return MakeToken(TokenKind::IntLiteral, m, L, C); 
-            }
+            if (match(LexRule::HexInt, RX_INT_HEX)) return emit(TokenKind::IntLiteral, m);
 
-            if (MatchAtBegin(sv, RX_FLOAT, m)) { 
-                AdvanceCursor(m); 
-                return MakeToken(TokenKind::FloatLiteral, m, L, C); 
-            }
+            if (match(LexRule::Float, RX_FLOAT)) return emit(TokenKind::FloatLiteral, m);
 
-            if (MatchAtBegin(sv, RX_INT_DEC, m)) { 
-                AdvanceCursor(m); 
-                return MakeToken(TokenKind::IntLiteral, m, L, C); 
-            }
+            if (match(LexRule::DecInt, RX_INT_DEC)) return emit(TokenKind::IntLiteral, m);
 
-            if (MatchAtBegin(sv, RX_IDENT, m)) {
-                AdvanceCursor(m);
+            // RX_IDENT only knows ASCII; UTF-8 characters in names go through the
+            // dispatch engine's scanner so both engines agree.
+            if (match(LexRule::Identifier, RX_IDENT)) {
+                const size_t len = detail::ScanIdentifier(sv.data(), sv.size(), m.size(), options_.standard);
+                if (len != m.size()) return emit(TokenKind::Identifier, sv.substr(0, len));
 
-                if (kKeywords.count(m)) {
-                    return Token{ TokenKind::Keyword, m, { L, C }, {} };
-                }
+                RuleProbe lookup(StatsSink());
+                bool keyword = IsKeyword(m, options_.standard);
+                lookup.Record(LexRule::KeywordLookup, keyword, m.size());
 
-                return Token{ TokenKind::Identifier, m, { L, C }, {} };
+                return emit(keyword ? TokenKind::Keyword : TokenKind::Identifier, m);
             }
 
-            if (MatchAtBegin(sv, RX_OP_ALL, m)) {
-                if (m == "...") { 
-                    AdvanceCursor(m); 
-                    return MakeToken(TokenKind::Ellipsis, m, L, C); 
+            if (static_cast<unsigned char>(sv[0]) >= 0x80) {
+                if (size_t n = detail::ExtendedIdentifierLength(sv.data(), sv.size(), options_.standard, true)) {
+                    return emit(TokenKind::Identifier, sv.substr(0, detail::ScanIdentifier(sv.data(), sv.size(), n, options_.standard)));
                 }
 
-                if (m == "##") { 
-                    AdvanceCursor(m); 
-                    return MakeToken(TokenKind::MacroConcat, m, L, C); 
-                }
+                const char* message;
+                const size_t len = detail::UnknownCharLength(sv.data(), sv.size(), message);
+                RuleProbe(StatsSink()).Record(LexRule::Unknown, false, 0);
+                return emit(TokenKind::Error, sv.substr(0, len), message);
+            }
 
-                if (m == "#") { 
-                    AdvanceCursor(m); 
-                    return MakeToken(TokenKind::MacroHash, m, L, C); 
-                }
+            if (match(LexRule::Operator, RX_OP_ALL)) {
+                if (m == "...") return emit(TokenKind::Ellipsis, m);
+
+                if (m == "##") return emit(TokenKind::MacroConcat, m);
+
+                if (m == "#") return emit(TokenKind::MacroHash, m);
 
                 if (m.size() == 1 && string("(),;{}[]").find(m[0]) != string::npos) {
-                    AdvanceCursor(m); 
-                    return MakeToken(TokenKind::Punctuator, m, L, C);
+                    return emit(TokenKind::Punctuator, m);
                 }
 
-                AdvanceCursor(m); return MakeToken(TokenKind::Operator, m, L, C);
+                return emit(TokenKind::Operator, m);
             }
 
-            string one(1, sv[0]);
-            AdvanceCursor(one);
-            return MakeToken(TokenKind::Error, one, L, C, "Unknown token");
+            RuleProbe(StatsSink()).Record(LexRule::Unknown, false, 0);
+            return emit(TokenKind::Error, sv.substr(0, 1), "Unknown token");
+        }
+
+        return false;
+    }
+
+    bool Lexer::ScanWithDispatch(RawToken& out) {
+        if (!options_.trackPositions) return detail::ScanToken<OffsetsPolicy>(source_, options_.standard, index_, line_, column_, out, StatsSink());
+        return options_.codePointColumns
+            ? detail::ScanToken<CodePointPolicy>(source_, options_.standard, index_, line_, column_, out, StatsSink())
+            : detail::ScanToken<DefaultPolicy>(source_, options_.standard, index_, line_, column_, out, StatsSink());
+    }
+
+    bool Lexer::ScanRawToken(RawToken& out) {
+        const bool scanned = options_.engine == ScanEngine::Regex ? ScanWithRegex(out) : ScanWithDispatch(out);
+        if (scanned && out.kind == TokenKind::Error && options_.recoverFromErrors) ExtendUnknownRun(out);
+        return scanned;
+    }
+
+    // Recovery reports a run of characters that cannot start a token as one
+    // error rather than one per character. The run never holds a newline.
+    void Lexer::ExtendUnknownRun(RawToken& error) {
+        // Length of the character at i if it cannot start a token, else 0.
+        auto unknown = [&](size_t i) -> size_t {
+            const unsigned char c = static_cast<unsigned char>(source_[i]);
+            if (c < 0x80) return detail::kCharClass[c] == detail::CharClass::Unknown ? 1 : 0;
+
+            const char* p = source_.data() + i;
+            const size_t avail = source_.size() - i;
+            if (detail::ExtendedIdentifierLength(p, avail, options_.standard, true)) return 0;
+            const char* message;
+            return detail::UnknownCharLength(p, avail, message);
+        };
+        if (!unknown(error.offset)) return;
+
+        size_t end = error.offset + error.length;
+        while (end < source_.size()) {
+            const size_t n = unknown(end);
+            if (n == 0) break;
+            end += n;
+        }
+
+        const string_view extra = source_.substr(index_, end - index_);
+        index_ = end;
+        column_ += static_cast<int>(options_.codePointColumns ? CountCodePoints(extra) : extra.size());
+        error.length = end - error.offset;
+    }
+
+    // Errors always get a position, even when nothing else is tracked.
+    bool Lexer::NextRawToken(RawToken& out) {
+        if (!ScanRawToken(out)) return false;
+        if (out.kind == TokenKind::Error && !options_.trackPositions) out.pos = ErrorPosition(out.offset);
+        return true;
+    }
+
+    // What ScanRawToken and NextRawToken add to an Error from the scan core.
+    void Lexer::FinishError(RawToken& error) {
+        if (options_.recoverFromErrors) ExtendUnknownRun(error);
+        if (!options_.trackPositions) error.pos = ErrorPosition(error.offset);
+    }
+
+    Token Lexer::GetNextToken() {
+        RawToken raw;
+        if (!NextRawToken(raw)) {
+            return Token{ TokenKind::EndOfFile, "", CursorPos(), {} };
         }
 
-        return Token{ TokenKind::EndOfFile, "", { line_, column_ }, {} };
+        Token t = MakeToken(raw.kind,
+            source_.substr(raw.offset, raw.length),
+            raw.pos.line,
+            raw.pos.column,
+            raw.message ? raw.message : string());
+
+        if (options_.symbols && t.kind == TokenKind::Identifier) t.symbol = options_.symbols->Intern(t.lexeme);
+        return t;
+    }
+
+    TokenRange Lexer::Tokens() {
+        return TokenRange(*this);
+    }
+
+    // Typical C runs at 5 to 7 bytes per token; erring low costs at most one
+    // regrowth, while comment-heavy files are not over-reserved by much.
+    size_t Lexer::EstimateTokenCount(size_t bytes) {
+        return bytes / 8 + 16;
     }
 
     vector<Token> Lexer::TokenizeAll() {
         vector<Token> out;
+        out.reserve(EstimateTokenCount(source_.size() - index_));
 
+        size_t errors = 0;
         while (true) {
             Token t = GetNextToken();
             out.push_back(move(t));
 
-            if (out.back().kind == TokenKind::EndOfFile || out.back().kind == TokenKind::Error) break;
+            if (out.back().kind == TokenKind::EndOfFile) break;
+            if (out.back().kind == TokenKind::Error && options_.StopAfter(++errors)) break;
+        }
+        return out;
+    }
+
+    pmr::vector<PmrToken> Lexer::TokenizeAll(pmr::memory_resource* resource) {
+        pmr::vector<PmrToken> out(resource);
+        out.reserve(EstimateTokenCount(source_.size() - index_));
+
+        SymbolTable* const symbols = options_.symbols;
+        size_t errors = 0;
+        RawToken raw;
+        while (NextRawToken(raw)) {
+            string_view lexeme = source_.substr(raw.offset, raw.length);
+            uint32_t symbol = symbols && raw.kind == TokenKind::Identifier ? symbols->Intern(lexeme) : kNoSymbol;
+            out.emplace_back(raw.kind, lexeme, raw.pos, raw.message ? string_view(raw.message) : string_view(), symbol);
+
+            if (raw.kind == TokenKind::Error && options_.StopAfter(++errors)) return out;
+        }
+
+        out.emplace_back(TokenKind::EndOfFile, string_view(), CursorPos(), string_view(), kNoSymbol);
+        return out;
+    }
+
+    // The dispatch loop of a batch works on a copy of the cursor, so once the
+    // scan core is inlined the cursor stays in registers for the whole batch.
+    // Errors are rare enough to sync through the members.
+    template <class Policy, class Emit>
+    size_t Lexer::ScanBatch(size_t capacity, Emit&& emit) {
+        size_t index = index_;
+        int line = line_, column = column_;
+        size_t n = 0;
+
+        RawToken raw;
+        while (n < capacity && !batchDone_) {
+            if (!detail::ScanToken<Policy>(source_, options_.standard, index, line, column, raw, StatsSink())) {
+                const SourcePos end = Policy::kPositions ? SourcePos{ line, column } : SourcePos{ 0, 0 };
+                emit(n++, RawToken{ TokenKind::EndOfFile, index, 0, end, nullptr });
+                batchDone_ = true;
+                break;
+            }
+
+            if (raw.kind == TokenKind::Error) {
+                index_ = index;
+                line_ = line;
+                column_ = column;
+                FinishError(raw);
+                index = index_;
+                line = line_;
+                column = column_;
+                batchDone_ = options_.StopAfter(++batchErrors_);
+            }
+            emit(n++, raw);
+        }
+
+        index_ = index;
+        line_ = line;
+        column_ = column;
+        return n;
+    }
+
+    template <class Emit>
+    size_t Lexer::FillBatch(size_t capacity, Emit&& emit) {
+        if (options_.engine == ScanEngine::Dispatch) {
+            if (!options_.trackPositions) return ScanBatch<OffsetsPolicy>(capacity, emit);
+            return options_.codePointColumns ? ScanBatch<CodePointPolicy>(capacity, emit) : ScanBatch<DefaultPolicy>(capacity, emit);
+        }
+
+        size_t n = 0;
+        RawToken raw;
+        while (n < capacity && !batchDone_) {
+            if (!NextRawToken(raw)) {
+                emit(n++, RawToken{ TokenKind::EndOfFile, index_, 0, CursorPos(), nullptr });
+                batchDone_ = true;
+                break;
+            }
+
+            if (raw.kind == TokenKind::Error) batchDone_ = options_.StopAfter(++batchErrors_);
+            emit(n++, raw);
+        }
+        return n;
+    }
+
+    size_t Lexer::NextBatch(Token* out, size_t capacity) {
+        SymbolTable* const symbols = options_.symbols;
+        return FillBatch(capacity, [&](size_t i, const RawToken& raw) {
+            Token& t = out[i];
+            t.kind = raw.kind;
+            t.lexeme.assign(source_.data() + raw.offset, raw.length);
+            t.pos = raw.pos;
+            if (raw.message) t.message = raw.message;
+            else t.message.clear();
+            t.symbol = symbols && raw.kind == TokenKind::Identifier ? symbols->Intern(t.lexeme) : kNoSymbol;
+        });
+    }
+
+    size_t Lexer::NextBatch(CompactTokenStream& batch, size_t capacity) {
+        batch.source = source_;
+        batch.tokens.clear();
+        batch.diagnostics.clear();
+        batch.symbols.clear();
+        batch.tokens.reserve(capacity);
+
+        SymbolTable* const symbols = options_.symbols;
+        return FillBatch(capacity, [&](size_t i, const RawToken& raw) {
+            batch.tokens.push_back(MakeCompactToken(raw.kind, raw.offset, raw.length, raw.pos));
+            if (raw.message) batch.diagnostics.push_back({ static_cast<uint32_t>(i), raw.message });
+            if (symbols) {
+                batch.symbols.push_back(raw.kind == TokenKind::Identifier
+                    ? symbols->Intern(source_.substr(raw.offset, raw.length)) : kNoSymbol);
+            }
+        });
+    }
+
+    // Replaces `out` with one Error token when the source is too large for
+    // CompactToken's 32-bit offsets; the Token API has no such limit.
+    bool Lexer::RejectOversized(CompactTokenStream& out) const {
+        if (source_.size() <= kMaxCompactSource) return false;
+
+        out.source = source_;
+        out.tokens.assign(1, MakeCompactToken(TokenKind::Error, 0, 0, { 1, 1 }));
+        out.diagnostics.assign(1, { 0, "Source larger than 4 GiB" });
+        out.symbols.clear();
+        if (options_.symbols) out.symbols.push_back(kNoSymbol);
+        return true;
+    }
+
+    CompactTokenStream Lexer::TokenizeAllCompact() {
+        CompactTokenStream out;
+        if (RejectOversized(out)) return out;
+        out.source = source_;
+        out.tokens.reserve(EstimateTokenCount(source_.size() - index_));
+
+        SymbolTable* const symbols = options_.symbols;
+        RawToken raw;
+        while (NextRawToken(raw)) {
+            out.tokens.push_back(MakeCompactToken(raw.kind, raw.offset, raw.length, raw.pos));
+            if (symbols) {
+                out.symbols.push_back(raw.kind == TokenKind::Identifier
+                    ? symbols->Intern(source_.substr(raw.offset, raw.length)) : kNoSymbol);
+            }
+
+            if (raw.kind == TokenKind::Error) {
+                out.diagnostics.push_back({ static_cast<uint32_t>(out.tokens.size() - 1), raw.message });
+                if (options_.StopAfter(out.diagnostics.size())) return out;
+            }
         }
+
+        out.tokens.push_back(MakeCompactToken(TokenKind::EndOfFile, index_, 0, CursorPos()));
+        if (symbols) out.symbols.push_back(kNoSymbol);
         return out;
     }
 
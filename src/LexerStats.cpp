@@ -0,0 +1,65 @@
+#include "lexer/LexerStats.hpp"
+#ifdef CLEX_STATS
+#include <cstdlib>
+#include <new>
+#endif
+using namespace std;
+
+namespace clex {
+
+#ifdef CLEX_STATS
+    namespace {
+        thread_local uint64_t tAllocations = 0;
+    }
+
+    uint64_t ThreadAllocations() { return tAllocations; }
+
+    void CountAllocation() { ++tAllocations; }
+#else
+    uint64_t ThreadAllocations() { return 0; }
+#endif
+
+    string_view RuleName(LexRule rule) {
+        switch (rule) {
+        case LexRule::Whitespace:    return "Whitespace";
+        case LexRule::Preprocessor:  return "Preprocessor";
+        case LexRule::LineComment:   return "LineComment";
+        case LexRule::BlockComment:  return "BlockComment";
+        case LexRule::StringLiteral: return "StringLiteral";
+        case LexRule::CharLiteral:   return "CharLiteral";
+        case LexRule::HexInt:        return "HexInt";
+        case LexRule::Float:         return "Float";
+        case LexRule::DecInt:        return "DecInt";
+        case LexRule::Identifier:    return "Identifier";
+        case LexRule::KeywordLookup: return "KeywordLookup";
+        case LexRule::Operator:      return "Operator";
+        case LexRule::Unknown:       return "Unknown";
+        }
+        return "Unknown";
+    }
+
+    LexerStats& LexerStats::operator+=(const LexerStats& other) {
+        for (size_t i = 0; i < kLexRuleCount; ++i) {
+            rules[i].attempts += other.rules[i].attempts;
+            rules[i].matches += other.rules[i].matches;
+            rules[i].bytes += other.rules[i].bytes;
+            rules[i].cycles += other.rules[i].cycles;
+            rules[i].allocations += other.rules[i].allocations;
+        }
+        return *this;
+    }
+
+}
+
+#ifdef CLEX_STATS
+// Allocation counting replaces the global operator new for the whole program;
+// the array, nothrow and sized forms forward here by default.
+void* operator new(size_t size) {
+    clex::CountAllocation();
+    if (void* p = malloc(size ? size : 1)) return p;
+    throw bad_alloc();
+}
+
+void operator delete(void* p) noexcept { free(p); }
+void operator delete(void* p, size_t) noexcept { free(p); }
+#endif
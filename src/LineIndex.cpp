@@ -0,0 +1,42 @@
+#include "lexer/LineIndex.hpp"
+#include "lexer/Utf8.hpp"
+#include "lexer/detail/SimdScan.hpp"
+#include <algorithm>
+using namespace std;
+
+namespace clex {
+
+    LineIndex::LineIndex(string_view source) {
+        // C averages roughly one line per 30 bytes; the guess only saves regrowth.
+        starts_.reserve(source.size() / 32 + 1);
+        simd::Active().appendNewlines(source.data(), source.size(), 1, starts_);
+        starts_[0] = Utf8BomLength(source);
+    }
+
+    SourcePos LineIndex::PositionOf(size_t offset) const {
+        size_t line = static_cast<size_t>(upper_bound(starts_.begin(), starts_.end(), offset) - starts_.begin());
+        if (line == 0) return { 1, 1 };   // inside the BOM
+        return { static_cast<int>(line), static_cast<int>(offset - starts_[line - 1] + 1) };
+    }
+
+    SourcePos LineIndex::CodePointPositionOf(string_view source, size_t offset) const {
+        SourcePos pos = PositionOf(offset);
+        if (pos.column > 1) {
+            const size_t start = offset - static_cast<size_t>(pos.column - 1);
+            pos.column = 1 + static_cast<int>(CountCodePoints(source.substr(start, offset - start)));
+        }
+        return pos;
+    }
+
+    void LineIndex::Annotate(CompactTokenStream& stream) const {
+        size_t line = 1;
+        for (CompactToken& t : stream.tokens) {
+            while (line < starts_.size() && starts_[line] <= t.offset) ++line;
+
+            CompactToken positioned = MakeCompactToken(t.Kind(), t.offset, t.length,
+                { static_cast<int>(line), static_cast<int>(t.offset - starts_[line - 1] + 1) });
+            t = positioned;
+        }
+    }
+
+}
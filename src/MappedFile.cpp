@@ -0,0 +1,159 @@
+#include "lexer/MappedFile.hpp"
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <utility>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#include <io.h>
+#include <fcntl.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+using namespace std;
+
+namespace clex {
+
+    MappedFile::~MappedFile() { Close(); }
+
+    MappedFile::MappedFile(MappedFile&& other) noexcept { *this = move(other); }
+
+    MappedFile& MappedFile::operator=(MappedFile&& other) noexcept {
+        if (this == &other) return *this;
+        Close();
+
+        mapped_ = exchange(other.mapped_, false);
+        size_ = exchange(other.size_, 0);
+        buffer_ = move(other.buffer_);
+        error_ = move(other.error_);
+        data_ = mapped_ ? exchange(other.data_, nullptr) : buffer_.data();
+        other.data_ = nullptr;
+#ifdef _WIN32
+        mapping_ = exchange(other.mapping_, nullptr);
+#endif
+        return *this;
+    }
+
+    void MappedFile::Close() {
+        if (mapped_) {
+#ifdef _WIN32
+            UnmapViewOfFile(data_);
+            CloseHandle(static_cast<HANDLE>(mapping_));
+            mapping_ = nullptr;
+#else
+            munmap(const_cast<char*>(data_), size_);
+#endif
+        }
+        data_ = nullptr;
+        size_ = 0;
+        mapped_ = false;
+        buffer_.clear();
+    }
+
+    bool MappedFile::ReadAll(int fd) {
+        buffer_.clear();
+        size_t used = 0;
+
+        while (true) {
+            if (buffer_.size() - used < 64 * 1024) buffer_.resize(buffer_.size() + max<size_t>(64 * 1024, buffer_.size()));
+#ifdef _WIN32
+            int n = _read(fd, &buffer_[used], static_cast<unsigned>(buffer_.size() - used));
+#else
+            ssize_t n = read(fd, &buffer_[used], buffer_.size() - used);
+            if (n < 0 && errno == EINTR) continue;
+#endif
+            if (n < 0) { error_ = strerror(errno); return false; }
+            if (n == 0) break;
+            used += static_cast<size_t>(n);
+        }
+
+        buffer_.resize(used);
+        data_ = buffer_.data();
+        size_ = used;
+        return true;
+    }
+
+#ifdef _WIN32
+    bool MappedFile::Open(const string& path) {
+        Close();
+        error_.clear();
+
+        if (path == "-") {
+            _setmode(0, _O_BINARY);
+            return ReadAll(0);
+        }
+
+        HANDLE file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_DELETE,
+            nullptr, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+        if (file == INVALID_HANDLE_VALUE) { error_ = "cannot open file"; return false; }
+
+        LARGE_INTEGER size{};
+        bool ok = false;
+        if (GetFileType(file) == FILE_TYPE_DISK && GetFileSizeEx(file, &size)) {
+            if (size.QuadPart == 0) {
+                ok = true;
+            }
+            else if (HANDLE mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr)) {
+                if (const void* view = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0)) {
+                    data_ = static_cast<const char*>(view);
+                    size_ = static_cast<size_t>(size.QuadPart);
+                    mapping_ = mapping;
+                    mapped_ = ok = true;
+                }
+                else {
+                    CloseHandle(mapping);
+                }
+            }
+        }
+
+        if (!ok) {
+            int fd = _open_osfhandle(reinterpret_cast<intptr_t>(file), _O_RDONLY | _O_BINARY);
+            if (fd < 0) { CloseHandle(file); error_ = "cannot read file"; return false; }
+            ok = ReadAll(fd);
+            _close(fd);
+            return ok;
+        }
+
+        CloseHandle(file);
+        return true;
+    }
+#else
+    bool MappedFile::Open(const string& path) {
+        Close();
+        error_.clear();
+
+        if (path == "-") return ReadAll(STDIN_FILENO);
+
+        int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+        if (fd < 0) { error_ = strerror(errno); return false; }
+
+        struct stat st {};
+        if (fstat(fd, &st) == 0 && S_ISREG(st.st_mode)) {
+            if (st.st_size == 0) { close(fd); return true; }
+
+            void* view = mmap(nullptr, static_cast<size_t>(st.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+            if (view != MAP_FAILED) {
+#ifdef MADV_SEQUENTIAL
+                madvise(view, static_cast<size_t>(st.st_size), MADV_SEQUENTIAL);
+#endif
+                close(fd);
+                data_ = static_cast<const char*>(view);
+                size_ = static_cast<size_t>(st.st_size);
+                mapped_ = true;
+                return true;
+            }
+        }
+
+        bool ok = ReadAll(fd);
+        close(fd);
+        return ok;
+    }
+#endif
+
+}
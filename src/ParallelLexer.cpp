@@ -0,0 +1,198 @@
+#include "lexer/Lexer.hpp"
+#include "lexer/SymbolTable.hpp"
+#include "lexer/ThreadPool.hpp"
+#include "lexer/detail/SimdScan.hpp"
+#include <algorithm>
+#include <cstring>
+#include <mutex>
+using namespace std;
+
+namespace clex {
+
+    namespace {
+
+        constexpr size_t kMinChunkBytes = 128 * 1024;
+        constexpr size_t kChunksPerThread = 4;
+
+        size_t FirstTokenAtOrAfter(const vector<CompactToken>& tokens, size_t offset) {
+            return static_cast<size_t>(lower_bound(tokens.begin(), tokens.end(), offset,
+                [](const CompactToken& t, size_t o) { return t.offset < o; }) - tokens.begin());
+        }
+
+        // Interning waits for the stitched stream so that identifiers the
+        // speculative passes saw inside comments or strings never reach the table.
+        void InternStitched(ThreadPool& pool, CompactTokenStream& out, SymbolTable& table) {
+            out.symbols.resize(out.tokens.size(), kNoSymbol);
+
+            const size_t parts = pool.Size() * kChunksPerThread;
+            const size_t step = (out.tokens.size() + parts - 1) / parts;
+            for (size_t first = 0; first < out.tokens.size(); first += step) {
+                pool.Submit([&out, &table, first, step] { InternIdentifiers(out, table, first, first + step); });
+            }
+            pool.Wait();
+        }
+
+    }
+
+    // Lexes from the current cursor as if a token started there, keeping every
+    // token that starts before `end` (the last one may run past it) and lexing on
+    // past errors. Errors are speculative here, so untracked positions stay 0.
+    void Lexer::TokenizeChunk(size_t end, CompactTokenStream& out) {
+        RawToken raw;
+        while (ScanRawToken(raw) && raw.offset < end) {
+            out.tokens.push_back(MakeCompactToken(raw.kind, raw.offset, raw.length, raw.pos));
+            if (raw.message) out.diagnostics.push_back({ static_cast<uint32_t>(out.tokens.size() - 1), raw.message });
+        }
+    }
+
+    CompactTokenStream Lexer::TokenizeAllParallel(size_t threads) {
+        if (threads == 0) threads = ThreadPool::DefaultSize();
+        if (threads == 1 || source_.size() - index_ < 2 * kMinChunkBytes) return TokenizeAllCompact();
+
+        ThreadPool pool(threads);
+        return TokenizeAllParallel(pool);
+    }
+
+    // Every chunk after the first starts right after a newline and is lexed
+    // speculatively as if no token were open there. Stitching then walks the
+    // chunks in order: when the previous chunk's last token ends at a point the
+    // speculative stream also passed through, its tokens are adopted as-is with
+    // their lines shifted. Otherwise the chunk really started inside a block
+    // comment, string or similar, and only the bytes up to the point where the
+    // true and speculative streams meet again are re-lexed.
+    CompactTokenStream Lexer::TokenizeAllParallel(ThreadPool& pool) {
+        if (source_.size() > kMaxCompactSource) return TokenizeAllCompact();
+
+        const size_t start = index_;
+        const SourcePos startPos{ line_, column_ };
+        const size_t size = source_.size();
+
+        vector<size_t> bounds{ start };
+        size_t chunkCount = min(pool.Size() * kChunksPerThread, (size - start) / kMinChunkBytes);
+        for (size_t k = 1; k < chunkCount; ++k) {
+            size_t target = max(start + (size - start) / chunkCount * k, bounds.back());
+            const void* nl = memchr(source_.data() + target, '\n', size - target);
+            if (!nl) break;
+
+            size_t b = static_cast<size_t>(static_cast<const char*>(nl) - source_.data()) + 1;
+            if (b > bounds.back() && b < size) bounds.push_back(b);
+        }
+        bounds.push_back(size);
+        chunkCount = bounds.size() - 1;
+
+        if (chunkCount < 2) return TokenizeAllCompact();
+
+        vector<CompactTokenStream> spec(chunkCount);
+        vector<size_t> newlines(chunkCount);
+        mutex statsLock;
+        for (size_t k = 0; k < chunkCount; ++k) {
+            pool.Submit([&, k] {
+                Lexer chunkLexer(source_, options_);
+                chunkLexer.Seek(bounds[k], { 1, k == 0 ? startPos.column : 1 });
+                chunkLexer.TokenizeChunk(bounds[k + 1], spec[k]);
+                if (options_.trackPositions) newlines[k] = simd::Active().countNewlines(source_.data() + bounds[k], bounds[k + 1] - bounds[k]);
+                if constexpr (kStatsEnabled) {
+                    lock_guard<mutex> guard(statsLock);
+                    MergeStats(chunkLexer);
+                }
+            });
+        }
+        pool.Wait();
+
+        CompactTokenStream out;
+        out.source = source_;
+
+        size_t total = 0;
+        for (const CompactTokenStream& s : spec) total += s.tokens.size();
+        out.tokens.reserve(total + 1);
+
+        Lexer repair(source_, options_);
+        size_t p = start;
+        SourcePos pos = startPos;
+        uint32_t chunkLine = static_cast<uint32_t>(startPos.line);
+        bool finished = false;
+
+        auto finish = [&] {
+            if (options_.symbols) InternStitched(pool, out, *options_.symbols);
+            MergeStats(repair);
+        };
+
+        auto append = [&](CompactToken t, string_view message) {
+            if (t.Kind() == TokenKind::Error && !options_.trackPositions) t = MakeCompactToken(t.Kind(), t.offset, t.length, ErrorPosition(t.offset));
+            out.tokens.push_back(t);
+            if (t.Kind() != TokenKind::Error) return true;
+
+            out.diagnostics.push_back({ static_cast<uint32_t>(out.tokens.size() - 1), message });
+            return !options_.StopAfter(out.diagnostics.size());
+        };
+
+        for (size_t k = 0; k < chunkCount && !finished; chunkLine += static_cast<uint32_t>(newlines[k]), ++k) {
+            if (p >= bounds[k + 1]) continue;
+
+            const vector<CompactToken>& tokens = spec[k].tokens;
+            size_t j = FirstTokenAtOrAfter(tokens, p);
+            bool aligned = j == 0 || tokens[j - 1].offset + tokens[j - 1].length <= p;
+
+            if (!aligned) {
+                repair.Seek(p, pos);
+                RawToken raw;
+                while (true) {
+                    if (!repair.ScanRawToken(raw)) {
+                        p = size;
+                        pos = repair.Position();
+                        finished = true;
+                        break;
+                    }
+
+                    if (raw.offset >= bounds[k + 1]) {
+                        p = raw.offset;
+                        pos = raw.pos;
+                        break;
+                    }
+
+                    j = FirstTokenAtOrAfter(tokens, raw.offset);
+                    if (j < tokens.size() && tokens[j].offset == raw.offset) {
+                        aligned = true;
+                        break;
+                    }
+
+                    p = raw.offset + raw.length;
+                    pos = repair.Position();
+                    if (!append(MakeCompactToken(raw.kind, raw.offset, raw.length, raw.pos), raw.message ? raw.message : "")) {
+                        Seek(p, pos);
+                        finish();
+                        return out;
+                    }
+                }
+            }
+
+            if (!aligned) continue;
+
+            for (size_t i = j; i < tokens.size(); ++i) {
+                CompactToken t = tokens[i];
+                if (options_.trackPositions) t.line += chunkLine - 1;
+
+                if (!append(t, t.Kind() == TokenKind::Error ? spec[k].Message(i) : string_view())) {
+                    Seek(t.offset + t.length, TokenEndPosition(source_, t, options_.codePointColumns));
+                    finish();
+                    return out;
+                }
+            }
+
+            if (j < tokens.size()) {
+                const CompactToken& last = out.tokens.back();
+                p = last.offset + last.length;
+                pos = TokenEndPosition(source_, last, options_.codePointColumns);
+            }
+        }
+
+        // Only whitespace can remain; the sequential scan places EOF after it.
+        Seek(p, pos);
+        RawToken raw;
+        while (NextRawToken(raw)) {}
+        out.tokens.push_back(MakeCompactToken(TokenKind::EndOfFile, index_, 0, CursorPos()));
+        finish();
+        return out;
+    }
+
+}
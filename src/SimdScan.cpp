@@ -0,0 +1,458 @@
+#include "lexer/detail/SimdScan.hpp"
+#include "lexer/Utf8.hpp"
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define CLEX_SIMD_X86 1
+#include <immintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+#endif
+
+#if defined(__GNUC__) || defined(__clang__)
+#define CLEX_TARGET_AVX2 __attribute__((target("avx2,popcnt")))
+#else
+#define CLEX_TARGET_AVX2
+#endif
+
+namespace clex::simd {
+
+    namespace {
+
+        inline bool IsSpace(char c) { return c == ' ' || c == '\t' || c == '\r' || c == '\n'; }
+
+        inline unsigned TrailingZeros(uint32_t mask) {
+#ifdef _MSC_VER
+            unsigned long index;
+            _BitScanForward(&index, mask);
+            return static_cast<unsigned>(index);
+#else
+            return static_cast<unsigned>(__builtin_ctz(mask));
+#endif
+        }
+
+        inline unsigned PopCount(uint32_t mask) {
+#ifdef _MSC_VER
+            mask = mask - ((mask >> 1) & 0x55555555u);
+            mask = (mask & 0x33333333u) + ((mask >> 2) & 0x33333333u);
+            return (((mask + (mask >> 4)) & 0x0F0F0F0Fu) * 0x01010101u) >> 24;
+#else
+            return static_cast<unsigned>(__builtin_popcount(mask));
+#endif
+        }
+
+        size_t ScalarSkipWhitespace(const char* p, size_t n) {
+            size_t i = 0;
+            while (i < n && IsSpace(p[i])) ++i;
+            return i;
+        }
+
+        size_t ScalarFindCommentEnd(const char* p, size_t n) {
+            for (size_t i = 0; i + 1 < n; ++i) {
+                if (p[i] == '*' && p[i + 1] == '/') return i;
+            }
+            return n;
+        }
+
+        size_t ScalarFindQuoteOrEscape(const char* p, size_t n, char quote) {
+            size_t i = 0;
+            while (i < n && p[i] != quote && p[i] != '\\') ++i;
+            return i;
+        }
+
+        size_t ScalarCountNewlines(const char* p, size_t n) {
+            size_t count = 0;
+            for (size_t i = 0; i < n; ++i) count += p[i] == '\n';
+            return count;
+        }
+
+        void ScalarAppendNewlines(const char* p, size_t n, size_t base, std::vector<size_t>& out) {
+            for (size_t i = 0; i < n; ++i) {
+                if (p[i] == '\n') out.push_back(base + i);
+            }
+        }
+
+        // Eight bytes at a time while they are ASCII, one sequence at a time otherwise.
+        size_t ScalarValidateUtf8(const char* p, size_t n) {
+            size_t i = 0;
+            while (i < n) {
+                if (i + 8 <= n) {
+                    uint64_t word;
+                    memcpy(&word, p + i, sizeof(word));
+                    if (!(word & 0x8080808080808080ull)) {
+                        i += 8;
+                        continue;
+                    }
+                }
+                if (static_cast<unsigned char>(p[i]) < 0x80) {
+                    ++i;
+                    continue;
+                }
+
+                uint32_t cp;
+                const size_t length = DecodeUtf8(p + i, n - i, cp);
+                if (length == 0) return i;
+                i += length;
+            }
+            return n;
+        }
+
+        size_t ScalarCountCodePoints(const char* p, size_t n) {
+            size_t count = 0;
+            for (size_t i = 0; i < n; ++i) count += (static_cast<unsigned char>(p[i]) & 0xC0) != 0x80;
+            return count;
+        }
+
+#ifdef CLEX_SIMD_X86
+        size_t Sse2SkipWhitespace(const char* p, size_t n) {
+            const __m128i sp = _mm_set1_epi8(' '), tab = _mm_set1_epi8('\t');
+            const __m128i cr = _mm_set1_epi8('\r'), nl = _mm_set1_epi8('\n');
+
+            size_t i = 0;
+            for (; i + 16 <= n; i += 16) {
+                __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p + i));
+                __m128i ws = _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(v, sp), _mm_cmpeq_epi8(v, tab)),
+                    _mm_or_si128(_mm_cmpeq_epi8(v, cr), _mm_cmpeq_epi8(v, nl)));
+                uint32_t other = ~static_cast<uint32_t>(_mm_movemask_epi8(ws)) & 0xFFFFu;
+                if (other) return i + TrailingZeros(other);
+            }
+            return i + ScalarSkipWhitespace(p + i, n - i);
+        }
+
+        size_t Sse2FindCommentEnd(const char* p, size_t n) {
+            const __m128i star = _mm_set1_epi8('*'), slash = _mm_set1_epi8('/');
+
+            size_t i = 0;
+            for (; i + 17 <= n; i += 16) {
+                __m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p + i));
+                __m128i b = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p + i + 1));
+                uint32_t hit = static_cast<uint32_t>(_mm_movemask_epi8(
+                    _mm_and_si128(_mm_cmpeq_epi8(a, star), _mm_cmpeq_epi8(b, slash))));
+                if (hit) return i + TrailingZeros(hit);
+            }
+            return i + ScalarFindCommentEnd(p + i, n - i);
+        }
+
+        size_t Sse2FindQuoteOrEscape(const char* p, size_t n, char quote) {
+            const __m128i q = _mm_set1_epi8(quote), bs = _mm_set1_epi8('\\');
+
+            size_t i = 0;
+            for (; i + 16 <= n; i += 16) {
+                __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p + i));
+                uint32_t hit = static_cast<uint32_t>(_mm_movemask_epi8(
+                    _mm_or_si128(_mm_cmpeq_epi8(v, q), _mm_cmpeq_epi8(v, bs))));
+                if (hit) return i + TrailingZeros(hit);
+            }
+            return i + ScalarFindQuoteOrEscape(p + i, n - i, quote);
+        }
+
+        size_t Sse2CountNewlines(const char* p, size_t n) {
+            const __m128i nl = _mm_set1_epi8('\n');
+
+            size_t i = 0, count = 0;
+            for (; i + 16 <= n; i += 16) {
+                __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p + i));
+                count += PopCount(static_cast<uint32_t>(_mm_movemask_epi8(_mm_cmpeq_epi8(v, nl))));
+            }
+            return count + ScalarCountNewlines(p + i, n - i);
+        }
+
+        void Sse2AppendNewlines(const char* p, size_t n, size_t base, std::vector<size_t>& out) {
+            const __m128i nl = _mm_set1_epi8('\n');
+
+            size_t i = 0;
+            for (; i + 16 <= n; i += 16) {
+                __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p + i));
+                uint32_t hit = static_cast<uint32_t>(_mm_movemask_epi8(_mm_cmpeq_epi8(v, nl)));
+                for (; hit; hit &= hit - 1) out.push_back(base + i + TrailingZeros(hit));
+            }
+            ScalarAppendNewlines(p + i, n - i, base + i, out);
+        }
+
+        // ASCII blocks are skipped 16 bytes at a time; a block with a non-ASCII
+        // byte is decoded from there up to the next ASCII byte.
+        size_t Sse2ValidateUtf8(const char* p, size_t n) {
+            size_t i = 0;
+            while (i + 16 <= n) {
+                __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p + i));
+                uint32_t high = static_cast<uint32_t>(_mm_movemask_epi8(v));
+                if (!high) {
+                    i += 16;
+                    continue;
+                }
+
+                i += TrailingZeros(high);
+                do {
+                    uint32_t cp;
+                    const size_t length = DecodeUtf8(p + i, n - i, cp);
+                    if (length == 0) return i;
+                    i += length;
+                } while (i < n && static_cast<unsigned char>(p[i]) >= 0x80);
+            }
+            return i + ScalarValidateUtf8(p + i, n - i);
+        }
+
+        size_t Sse2CountCodePoints(const char* p, size_t n) {
+            const __m128i firstLead = _mm_set1_epi8(static_cast<char>(0xC0));
+
+            size_t i = 0, count = 0;
+            for (; i + 16 <= n; i += 16) {
+                // As signed bytes, continuation bytes are exactly those below 0xC0.
+                __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p + i));
+                count += 16 - PopCount(static_cast<uint32_t>(_mm_movemask_epi8(_mm_cmplt_epi8(v, firstLead))));
+            }
+            return count + ScalarCountCodePoints(p + i, n - i);
+        }
+
+        CLEX_TARGET_AVX2 size_t Avx2SkipWhitespace(const char* p, size_t n) {
+            const __m256i sp = _mm256_set1_epi8(' '), tab = _mm256_set1_epi8('\t');
+            const __m256i cr = _mm256_set1_epi8('\r'), nl = _mm256_set1_epi8('\n');
+
+            size_t i = 0;
+            for (; i + 32 <= n; i += 32) {
+                __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p + i));
+                __m256i ws = _mm256_or_si256(_mm256_or_si256(_mm256_cmpeq_epi8(v, sp), _mm256_cmpeq_epi8(v, tab)),
+                    _mm256_or_si256(_mm256_cmpeq_epi8(v, cr), _mm256_cmpeq_epi8(v, nl)));
+                uint32_t other = ~static_cast<uint32_t>(_mm256_movemask_epi8(ws));
+                if (other) return i + TrailingZeros(other);
+            }
+            return i + Sse2SkipWhitespace(p + i, n - i);
+        }
+
+        CLEX_TARGET_AVX2 size_t Avx2FindCommentEnd(const char* p, size_t n) {
+            const __m256i star = _mm256_set1_epi8('*'), slash = _mm256_set1_epi8('/');
+
+            size_t i = 0;
+            for (; i + 33 <= n; i += 32) {
+                __m256i a = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p + i));
+                __m256i b = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p + i + 1));
+                uint32_t hit = static_cast<uint32_t>(_mm256_movemask_epi8(
+                    _mm256_and_si256(_mm256_cmpeq_epi8(a, star), _mm256_cmpeq_epi8(b, slash))));
+                if (hit) return i + TrailingZeros(hit);
+            }
+            return i + Sse2FindCommentEnd(p + i, n - i);
+        }
+
+        CLEX_TARGET_AVX2 size_t Avx2FindQuoteOrEscape(const char* p, size_t n, char quote) {
+            const __m256i q = _mm256_set1_epi8(quote), bs = _mm256_set1_epi8('\\');
+
+            size_t i = 0;
+            for (; i + 32 <= n; i += 32) {
+                __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p + i));
+                uint32_t hit = static_cast<uint32_t>(_mm256_movemask_epi8(
+                    _mm256_or_si256(_mm256_cmpeq_epi8(v, q), _mm256_cmpeq_epi8(v, bs))));
+                if (hit) return i + TrailingZeros(hit);
+            }
+            return i + Sse2FindQuoteOrEscape(p + i, n - i, quote);
+        }
+
+        CLEX_TARGET_AVX2 size_t Avx2CountNewlines(const char* p, size_t n) {
+            const __m256i nl = _mm256_set1_epi8('\n');
+
+            size_t i = 0, count = 0;
+            for (; i + 32 <= n; i += 32) {
+                __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p + i));
+#ifdef _MSC_VER
+                count += __popcnt(static_cast<uint32_t>(_mm256_movemask_epi8(_mm256_cmpeq_epi8(v, nl))));
+#else
+                count += static_cast<size_t>(__builtin_popcount(static_cast<uint32_t>(_mm256_movemask_epi8(_mm256_cmpeq_epi8(v, nl)))));
+#endif
+            }
+            return count + Sse2CountNewlines(p + i, n - i);
+        }
+
+        CLEX_TARGET_AVX2 void Avx2AppendNewlines(const char* p, size_t n, size_t base, std::vector<size_t>& out) {
+            const __m256i nl = _mm256_set1_epi8('\n');
+
+            size_t i = 0;
+            for (; i + 32 <= n; i += 32) {
+                __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p + i));
+                uint32_t hit = static_cast<uint32_t>(_mm256_movemask_epi8(_mm256_cmpeq_epi8(v, nl)));
+                for (; hit; hit &= hit - 1) out.push_back(base + i + TrailingZeros(hit));
+            }
+            Sse2AppendNewlines(p + i, n - i, base + i, out);
+        }
+
+        // Error classes of the lookup-table UTF-8 check (Keiser and Lemire,
+        // "Validating UTF-8 In Less Than One Instruction Per Byte"). Three table
+        // lookups on the nibbles of each byte and its predecessor flag every
+        // malformed two-byte pair; a saturating subtract finds the third and
+        // fourth bytes that must be continuations.
+        constexpr uint8_t kTooShort = 1 << 0;       // lead byte not followed by a continuation
+        constexpr uint8_t kTooLong = 1 << 1;        // continuation after an ASCII byte
+        constexpr uint8_t kOverlong3 = 1 << 2;
+        constexpr uint8_t kTooLarge = 1 << 3;
+        constexpr uint8_t kSurrogate = 1 << 4;
+        constexpr uint8_t kOverlong2 = 1 << 5;
+        constexpr uint8_t kTooLarge1000 = 1 << 6;
+        constexpr uint8_t kOverlong4 = 1 << 6;
+        constexpr uint8_t kTwoConts = 1 << 7;       // continuation after a continuation
+        constexpr uint8_t kCarry = kTooShort | kTooLong | kTwoConts;
+
+        CLEX_TARGET_AVX2 __m256i Lookup16(__m256i nibbles, const uint8_t (&table)[16]) {
+            const __m128i t = _mm_loadu_si128(reinterpret_cast<const __m128i*>(table));
+            return _mm256_shuffle_epi8(_mm256_broadcastsi128_si256(t), nibbles);
+        }
+
+        // The input shifted right by N bytes, with the end of `prev` shifted in.
+        template <int N>
+        CLEX_TARGET_AVX2 __m256i Previous(__m256i input, __m256i prev) {
+            return _mm256_alignr_epi8(input, _mm256_permute2x128_si256(prev, input, 0x21), 16 - N);
+        }
+
+        CLEX_TARGET_AVX2 __m256i HighNibbles(__m256i v) {
+            return _mm256_and_si256(_mm256_srli_epi16(v, 4), _mm256_set1_epi8(0x0F));
+        }
+
+        CLEX_TARGET_AVX2 __m256i Utf8BlockErrors(__m256i input, __m256i prev) {
+            static const uint8_t kByte1High[16] = {
+                kTooLong, kTooLong, kTooLong, kTooLong, kTooLong, kTooLong, kTooLong, kTooLong,
+                kTwoConts, kTwoConts, kTwoConts, kTwoConts,
+                kTooShort | kOverlong2,
+                kTooShort,
+                kTooShort | kOverlong3 | kSurrogate,
+                kTooShort | kTooLarge | kTooLarge1000 | kOverlong4,
+            };
+            static const uint8_t kByte1Low[16] = {
+                kCarry | kOverlong3 | kOverlong2 | kOverlong4,
+                kCarry | kOverlong2,
+                kCarry,
+                kCarry,
+                kCarry | kTooLarge,
+                kCarry | kTooLarge | kTooLarge1000,
+                kCarry | kTooLarge | kTooLarge1000,
+                kCarry | kTooLarge | kTooLarge1000,
+                kCarry | kTooLarge | kTooLarge1000,
+                kCarry | kTooLarge | kTooLarge1000,
+                kCarry | kTooLarge | kTooLarge1000,
+                kCarry | kTooLarge | kTooLarge1000,
+                kCarry | kTooLarge | kTooLarge1000,
+                kCarry | kTooLarge | kTooLarge1000 | kSurrogate,
+                kCarry | kTooLarge | kTooLarge1000,
+                kCarry | kTooLarge | kTooLarge1000,
+            };
+            static const uint8_t kByte2High[16] = {
+                kTooShort, kTooShort, kTooShort, kTooShort, kTooShort, kTooShort, kTooShort, kTooShort,
+                kTooLong | kOverlong2 | kTwoConts | kOverlong3 | kTooLarge1000 | kOverlong4,
+                kTooLong | kOverlong2 | kTwoConts | kOverlong3 | kTooLarge,
+                kTooLong | kOverlong2 | kTwoConts | kSurrogate | kTooLarge,
+                kTooLong | kOverlong2 | kTwoConts | kSurrogate | kTooLarge,
+                kTooShort, kTooShort, kTooShort, kTooShort,
+            };
+
+            const __m256i prev1 = Previous<1>(input, prev);
+            const __m256i special = _mm256_and_si256(
+                _mm256_and_si256(Lookup16(HighNibbles(prev1), kByte1High),
+                    Lookup16(_mm256_and_si256(prev1, _mm256_set1_epi8(0x0F)), kByte1Low)),
+                Lookup16(HighNibbles(input), kByte2High));
+
+            const __m256i third = _mm256_subs_epu8(Previous<2>(input, prev), _mm256_set1_epi8(static_cast<char>(0xE0 - 0x80)));
+            const __m256i fourth = _mm256_subs_epu8(Previous<3>(input, prev), _mm256_set1_epi8(static_cast<char>(0xF0 - 0x80)));
+            const __m256i mustContinue = _mm256_and_si256(_mm256_or_si256(third, fourth), _mm256_set1_epi8(static_cast<char>(0x80)));
+            return _mm256_xor_si256(mustContinue, special);
+        }
+
+        // The blocks only say whether an error was seen, so the block that
+        // reports one is rescanned from the start of the sequence that runs into
+        // it (at most 3 bytes back) to find the exact offset.
+        CLEX_TARGET_AVX2 size_t Avx2ValidateUtf8(const char* p, size_t n) {
+            // Non-zero in the last three lanes when a sequence is still open there.
+            const __m256i incompleteAbove = _mm256_setr_epi8(
+                -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+                -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+                static_cast<char>(0xF0 - 1), static_cast<char>(0xE0 - 1), static_cast<char>(0xC0 - 1));
+
+            __m256i prev = _mm256_setzero_si256();
+            __m256i incomplete = _mm256_setzero_si256();
+            size_t i = 0;
+            for (; i + 32 <= n; i += 32) {
+                const __m256i input = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p + i));
+                __m256i error = incomplete;
+                if (_mm256_movemask_epi8(input) != 0) {
+                    error = Utf8BlockErrors(input, prev);
+                    incomplete = _mm256_subs_epu8(input, incompleteAbove);
+                }
+                else {
+                    incomplete = _mm256_setzero_si256();
+                }
+                if (!_mm256_testz_si256(error, error)) break;
+                prev = input;
+            }
+
+            size_t start = i;
+            for (size_t k = 1; k <= 3 && k <= i; ++k) {
+                const unsigned char b = static_cast<unsigned char>(p[i - k]);
+                if (b < 0x80) break;
+                if (b >= 0xC0) {
+                    start = i - k;
+                    break;
+                }
+            }
+            return start + ScalarValidateUtf8(p + start, n - start);
+        }
+
+        CLEX_TARGET_AVX2 size_t Avx2CountCodePoints(const char* p, size_t n) {
+            const __m256i firstLead = _mm256_set1_epi8(static_cast<char>(0xC0));
+
+            size_t i = 0, count = 0;
+            for (; i + 32 <= n; i += 32) {
+                __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p + i));
+                uint32_t continuations = static_cast<uint32_t>(_mm256_movemask_epi8(_mm256_cmpgt_epi8(firstLead, v)));
+#ifdef _MSC_VER
+                count += 32 - __popcnt(continuations);
+#else
+                count += 32 - static_cast<size_t>(__builtin_popcount(continuations));
+#endif
+            }
+            return count + Sse2CountCodePoints(p + i, n - i);
+        }
+
+        bool CpuHasAvx2() {
+#ifdef _MSC_VER
+            int info[4];
+            __cpuid(info, 0);
+            if (info[0] < 7) return false;
+
+            __cpuid(info, 1);
+            const bool osxsave = (info[2] & (1 << 27)) != 0;
+            const bool popcnt = (info[2] & (1 << 23)) != 0;
+            if (!osxsave || !popcnt || (_xgetbv(0) & 0x6) != 0x6) return false;
+
+            __cpuidex(info, 7, 0);
+            return (info[1] & (1 << 5)) != 0;
+#else
+            __builtin_cpu_init();
+            return __builtin_cpu_supports("avx2") && __builtin_cpu_supports("popcnt");
+#endif
+        }
+
+        const Kernels kSse2 = { "sse2", Sse2SkipWhitespace, Sse2FindCommentEnd, Sse2FindQuoteOrEscape, Sse2CountNewlines, Sse2AppendNewlines,
+                                 Sse2ValidateUtf8, Sse2CountCodePoints };
+        const Kernels kAvx2 = { "avx2", Avx2SkipWhitespace, Avx2FindCommentEnd, Avx2FindQuoteOrEscape, Avx2CountNewlines, Avx2AppendNewlines,
+                                 Avx2ValidateUtf8, Avx2CountCodePoints };
+#endif
+
+        const Kernels kScalar = { "scalar", ScalarSkipWhitespace, ScalarFindCommentEnd, ScalarFindQuoteOrEscape, ScalarCountNewlines, ScalarAppendNewlines,
+                                   ScalarValidateUtf8, ScalarCountCodePoints };
+
+    }
+
+    const Kernels& Scalar() { return kScalar; }
+
+#ifdef CLEX_SIMD_X86
+    const Kernels* Sse2() { return &kSse2; }
+    const Kernels* Avx2() { return CpuHasAvx2() ? &kAvx2 : nullptr; }
+#else
+    const Kernels* Sse2() { return nullptr; }
+    const Kernels* Avx2() { return nullptr; }
+#endif
+
+    const Kernels& Active() {
+        static const Kernels& active = Avx2() ? *Avx2() : Sse2() ? *Sse2() : Scalar();
+        return active;
+    }
+
+}
@@ -0,0 +1,156 @@
+#include "lexer/StreamLexer.hpp"
+#include "lexer/SymbolTable.hpp"
+#include "lexer/Utf8.hpp"
+#include <cerrno>
+#include <cstring>
+
+#ifdef _WIN32
+#include <io.h>
+#else
+#include <unistd.h>
+#endif
+using namespace std;
+
+namespace clex {
+
+    namespace {
+
+        // Bytes past a token's end that may still change how it is scanned.
+        constexpr size_t kLookahead = 4;
+
+        // True when the failing string literal at `start` gave up only because the
+        // window ended; a backslash before a line break fails regardless of what follows.
+        bool StringFailedAtWindowEnd(string_view window, size_t start) {
+            size_t i = start + 1;
+            while (i < window.size()) {
+                if (window[i] == '\\') {
+                    if (i + 1 >= window.size()) return true;
+                    if (window[i + 1] == '\n' || window[i + 1] == '\r') return false;
+                    i += 2;
+                }
+                else {
+                    ++i;
+                }
+            }
+            return true;
+        }
+
+    }
+
+    size_t IstreamSource::Read(char* dst, size_t capacity) {
+        in_.read(dst, static_cast<streamsize>(capacity));
+        return static_cast<size_t>(in_.gcount());
+    }
+
+    size_t FdSource::Read(char* dst, size_t capacity) {
+        while (true) {
+#ifdef _WIN32
+            int n = _read(fd_, dst, static_cast<unsigned>(capacity));
+#else
+            ssize_t n = read(fd_, dst, capacity);
+            if (n < 0 && errno == EINTR) continue;
+#endif
+            return n > 0 ? static_cast<size_t>(n) : 0;
+        }
+    }
+
+    StreamLexer::StreamLexer(ChunkSource& source, LexerOptions options, size_t chunkSize)
+        : source_(source), options_(options), chunkSize_(chunkSize ? chunkSize : 1) {
+        // The window never holds the whole input, so a line index cannot be built.
+        options_.trackPositions = true;
+    }
+
+    // Drops the consumed prefix, then reads at least `minRead` bytes unless the
+    // source runs dry first. Returns false once nothing more can be read.
+    bool StreamLexer::Fill(size_t minRead) {
+        if (eof_) return false;
+
+        if (begin_ > 0) {
+            memmove(&buffer_[0], buffer_.data() + begin_, size_ - begin_);
+            size_ -= begin_;
+            begin_ = 0;
+        }
+
+        if (buffer_.size() - size_ < minRead) buffer_.resize(size_ + minRead);
+
+        size_t target = size_ + minRead;
+        while (size_ < target) {
+            size_t n = source_.Read(&buffer_[size_], buffer_.size() - size_);
+            if (n == 0) {
+                eof_ = true;
+                break;
+            }
+            size_ += n;
+        }
+        return true;
+    }
+
+    // The first read may be shorter than a BOM, so wait for its 3 bytes.
+    void StreamLexer::SkipBom() {
+        if (started_) return;
+        started_ = true;
+        while (size_ < kUtf8Bom.size() && Fill(kUtf8Bom.size() - size_)) {}
+        begin_ = Utf8BomLength(string_view(buffer_.data(), size_));
+    }
+
+    bool StreamLexer::IsEndOfInput() {
+        SkipBom();
+        while (begin_ == size_) {
+            if (!Fill(chunkSize_)) return true;
+        }
+        return false;
+    }
+
+    Token StreamLexer::GetNextToken() {
+        SkipBom();
+        size_t want = chunkSize_;
+
+        while (true) {
+            string_view window(buffer_.data(), size_);
+            Lexer lexer(window, options_);
+            lexer.Seek(begin_, pos_);
+
+            Lexer::RawToken raw;
+            const bool scanned = lexer.NextRawToken(raw);
+            if constexpr (kStatsEnabled) stats_ += lexer.Stats();
+
+            if (!scanned) {
+                // Only whitespace left in the window: keep its effect on the position.
+                begin_ = lexer.Offset();
+                pos_ = lexer.Position();
+                if (!Fill(want)) return Token{ TokenKind::EndOfFile, "", pos_, {} };
+                continue;
+            }
+
+            bool complete = eof_;
+            if (!complete) {
+                const size_t end = raw.offset + raw.length;
+                complete = end + kLookahead <= size_;
+
+                if (raw.kind == TokenKind::Error && window[raw.offset] == '"') {
+                    complete = complete && !StringFailedAtWindowEnd(window, raw.offset);
+                }
+                else if (raw.kind == TokenKind::Error && window[raw.offset] == '/') {
+                    complete = false;   // unterminated block comment: the close may still arrive
+                }
+            }
+
+            if (!complete) {
+                // Skip the whitespace already scanned so compaction can drop it.
+                begin_ = raw.offset;
+                pos_ = raw.pos;
+                Fill(want);
+                want *= 2;   // geometric growth keeps rescans of one long token linear
+                continue;
+            }
+
+            begin_ = lexer.Offset();
+            pos_ = lexer.Position();
+            Token t{ raw.kind, string(window.substr(raw.offset, raw.length)), raw.pos,
+                raw.message ? string(raw.message) : string() };
+            if (options_.symbols && t.kind == TokenKind::Identifier) t.symbol = options_.symbols->Intern(t.lexeme);
+            return t;
+        }
+    }
+
+}
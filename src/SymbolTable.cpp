@@ -0,0 +1,144 @@
+#include "lexer/SymbolTable.hpp"
+#include "lexer/Hash.hpp"
+#include <algorithm>
+#include <cstring>
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+using namespace std;
+
+namespace clex {
+
+    namespace {
+
+        constexpr size_t kArenaBlockBytes = 64 * 1024;
+
+        unsigned HighestBit(uint64_t v) {
+#ifdef _MSC_VER
+            unsigned long index;
+            _BitScanReverse64(&index, v);
+            return static_cast<unsigned>(index);
+#else
+            return 63u - static_cast<unsigned>(__builtin_clzll(v));
+#endif
+        }
+
+    }
+
+    struct SymbolTable::Shard {
+        struct Entry {
+            uint64_t hash = 0;
+            uint32_t id = kNoSymbol;
+        };
+
+        mutable mutex             lock;
+        vector<Entry>             index = vector<Entry>(64);
+        size_t                    used = 0;
+        vector<unique_ptr<char[]>> arena;
+        char*                     cursor = nullptr;
+        size_t                    left = 0;
+
+        const char* Copy(string_view name) {
+            if (name.size() > left) {
+                size_t bytes = max(kArenaBlockBytes, name.size());
+                arena.push_back(make_unique<char[]>(bytes));
+                cursor = arena.back().get();
+                left = bytes;
+            }
+
+            char* out = cursor;
+            memcpy(out, name.data(), name.size());
+            cursor += name.size();
+            left -= name.size();
+            return out;
+        }
+
+        void Grow() {
+            vector<Entry> old(index.size() * 2);
+            swap(old, index);
+            const size_t mask = index.size() - 1;
+            for (const Entry& e : old) {
+                if (e.id == kNoSymbol) continue;
+                size_t i = static_cast<size_t>(e.hash) & mask;
+                while (index[i].id != kNoSymbol) i = (i + 1) & mask;
+                index[i] = e;
+            }
+        }
+    };
+
+    SymbolTable::SymbolTable() {
+        for (auto& shard : shards_) shard = make_unique<Shard>();
+    }
+
+    SymbolTable::~SymbolTable() {
+        for (auto& block : blocks_) delete[] block.load(memory_order_relaxed);
+    }
+
+    // Block b holds IDs [2^(b+k) - 2^k, 2^(b+k+1) - 2^k) for k = kFirstBlockBits.
+    string_view* SymbolTable::Slot(uint32_t id) const {
+        const uint64_t biased = static_cast<uint64_t>(id) + (1u << kFirstBlockBits);
+        const unsigned top = HighestBit(biased);
+        string_view* block = blocks_[top - kFirstBlockBits].load(memory_order_acquire);
+        return block + (biased - (uint64_t(1) << top));
+    }
+
+    string_view* SymbolTable::GrowTo(uint32_t id) {
+        const uint64_t biased = static_cast<uint64_t>(id) + (1u << kFirstBlockBits);
+        const unsigned top = HighestBit(biased);
+        atomic<string_view*>& block = blocks_[top - kFirstBlockBits];
+
+        if (!block.load(memory_order_acquire)) {
+            lock_guard<mutex> guard(growLock_);
+            if (!block.load(memory_order_relaxed)) block.store(new string_view[size_t(1) << top], memory_order_release);
+        }
+        return Slot(id);
+    }
+
+    uint32_t SymbolTable::Intern(string_view name) {
+        const uint64_t hash = HashBytes(name);
+        Shard& shard = *shards_[hash >> 58];
+
+        lock_guard<mutex> guard(shard.lock);
+        size_t mask = shard.index.size() - 1;
+        size_t i = static_cast<size_t>(hash) & mask;
+        for (; shard.index[i].id != kNoSymbol; i = (i + 1) & mask) {
+            const Shard::Entry& e = shard.index[i];
+            if (e.hash == hash && *Slot(e.id) == name) return e.id;
+        }
+
+        const uint32_t id = next_.fetch_add(1, memory_order_acq_rel);
+        *GrowTo(id) = string_view(shard.Copy(name), name.size());
+        shard.index[i] = { hash, id };
+
+        if (++shard.used * 4 > shard.index.size() * 3) shard.Grow();
+        return id;
+    }
+
+    uint32_t SymbolTable::Find(string_view name) const {
+        const uint64_t hash = HashBytes(name);
+        const Shard& shard = *shards_[hash >> 58];
+
+        lock_guard<mutex> guard(shard.lock);
+        const size_t mask = shard.index.size() - 1;
+        for (size_t i = static_cast<size_t>(hash) & mask; shard.index[i].id != kNoSymbol; i = (i + 1) & mask) {
+            const Shard::Entry& e = shard.index[i];
+            if (e.hash == hash && *Slot(e.id) == name) return e.id;
+        }
+        return kNoSymbol;
+    }
+
+    string_view SymbolTable::Name(uint32_t id) const { return *Slot(id); }
+
+    void InternIdentifiers(CompactTokenStream& stream, SymbolTable& table, size_t first, size_t last) {
+        // Already-sized streams are only written within the range, so disjoint
+        // ranges can be interned concurrently.
+        last = min(last, stream.tokens.size());
+        if (stream.symbols.size() != stream.tokens.size()) stream.symbols.resize(stream.tokens.size(), kNoSymbol);
+
+        for (size_t i = first; i < last; ++i) {
+            const CompactToken& t = stream.tokens[i];
+            stream.symbols[i] = t.Kind() == TokenKind::Identifier ? table.Intern(stream.Lexeme(t)) : kNoSymbol;
+        }
+    }
+
+}
@@ -0,0 +1,99 @@
+#include "lexer/ThreadPool.hpp"
+using namespace std;
+
+namespace clex {
+
+    namespace {
+        thread_local const ThreadPool* tlsPool = nullptr;
+        thread_local size_t tlsWorker = 0;
+    }
+
+    size_t ThreadPool::DefaultSize() {
+        unsigned n = thread::hardware_concurrency();
+        return n ? n : 1;
+    }
+
+    ThreadPool::ThreadPool(size_t threads) {
+        if (threads == 0) threads = DefaultSize();
+
+        for (size_t i = 0; i < threads; ++i) workers_.push_back(make_unique<Worker>());
+        for (size_t i = 0; i < threads; ++i) threads_.emplace_back([this, i] { Run(i); });
+    }
+
+    ThreadPool::~ThreadPool() {
+        {
+            lock_guard<mutex> guard(stateLock_);
+            stopping_ = true;
+        }
+        wake_.notify_all();
+        for (thread& t : threads_) t.join();
+    }
+
+    void ThreadPool::Submit(function<void()> task) {
+        size_t target = tlsPool == this ? tlsWorker : nextWorker_.fetch_add(1) % workers_.size();
+        {
+            // Count first so a worker can never finish the task before it is pending.
+            lock_guard<mutex> guard(stateLock_);
+            ++queued_;
+            ++pending_;
+        }
+        {
+            lock_guard<mutex> guard(workers_[target]->lock);
+            workers_[target]->tasks.push_back(move(task));
+        }
+        wake_.notify_one();
+    }
+
+    void ThreadPool::Wait() {
+        unique_lock<mutex> guard(stateLock_);
+        idle_.wait(guard, [this] { return pending_ == 0; });
+    }
+
+    bool ThreadPool::TryPop(size_t self, function<void()>& task) {
+        {
+            Worker& own = *workers_[self];
+            lock_guard<mutex> guard(own.lock);
+            if (!own.tasks.empty()) {
+                task = move(own.tasks.back());
+                own.tasks.pop_back();
+                return true;
+            }
+        }
+
+        for (size_t step = 1; step < workers_.size(); ++step) {
+            Worker& victim = *workers_[(self + step) % workers_.size()];
+            lock_guard<mutex> guard(victim.lock);
+            if (!victim.tasks.empty()) {
+                task = move(victim.tasks.front());
+                victim.tasks.pop_front();
+                return true;
+            }
+        }
+        return false;
+    }
+
+    void ThreadPool::Run(size_t self) {
+        tlsPool = this;
+        tlsWorker = self;
+
+        while (true) {
+            function<void()> task;
+            if (TryPop(self, task)) {
+                {
+                    lock_guard<mutex> guard(stateLock_);
+                    --queued_;
+                }
+                task();
+
+                lock_guard<mutex> guard(stateLock_);
+                if (--pending_ == 0) idle_.notify_all();
+                continue;
+            }
+
+            unique_lock<mutex> guard(stateLock_);
+            wake_.wait(guard, [this] { return stopping_ || queued_ > 0; });
+            if (stopping_ && queued_ == 0) return;
+        }
+    }
+
+}
@@ -1,8 +1,10 @@
 #include "lexer/Token.hpp"
+#include "lexer/detail/SimdScan.hpp"
+#include <algorithm>
 using namespace std;
 
 namespace clex {
-    string to_string(TokenKind k) {
+    string_view KindName(TokenKind k) {
         switch (k) {
         case TokenKind::Identifier:   return "Identifier";
         case TokenKind::Keyword:      return "Keyword";
@@ -22,4 +24,59 @@ namespace clex {
         }
         return "Unknown";
     }
+
+    string to_string(TokenKind k) { return string(KindName(k)); }
+
+    PmrToken::PmrToken(const allocator_type& alloc)
+        : lexeme(alloc), message(alloc) {}
+
+    PmrToken::PmrToken(TokenKind kind, string_view lexeme, SourcePos pos, string_view message, uint32_t symbol,
+        const allocator_type& alloc)
+        : kind(kind), lexeme(lexeme, alloc), pos(pos), message(message, alloc), symbol(symbol) {}
+
+    PmrToken::PmrToken(const PmrToken& other, const allocator_type& alloc)
+        : kind(other.kind), lexeme(other.lexeme, alloc), pos(other.pos), message(other.message, alloc), symbol(other.symbol) {}
+
+    PmrToken::PmrToken(PmrToken&& other, const allocator_type& alloc)
+        : kind(other.kind), lexeme(move(other.lexeme), alloc), pos(other.pos), message(move(other.message), alloc), symbol(other.symbol) {}
+
+    CompactToken MakeCompactToken(TokenKind kind, size_t offset, size_t length, SourcePos pos) {
+        constexpr uint32_t kMaxColumn = (1u << 24) - 1;
+        uint32_t column = static_cast<uint32_t>(pos.column);
+
+        CompactToken t;
+        t.offset = static_cast<uint32_t>(offset);
+        t.length = static_cast<uint32_t>(length);
+        t.line = static_cast<uint32_t>(pos.line);
+        t.column = column > kMaxColumn ? kMaxColumn : column;
+        t.kind = static_cast<uint32_t>(kind);
+        return t;
+    }
+
+    SourcePos TokenEndPosition(string_view source, const CompactToken& t, bool codePoints) {
+        string_view text = source.substr(t.offset, t.length);
+        size_t newlines = simd::Active().countNewlines(text.data(), text.size());
+        if (newlines == 0) {
+            const size_t columns = codePoints ? simd::Active().countCodePoints(text.data(), text.size()) : text.size();
+            return { static_cast<int>(t.line), static_cast<int>(t.column + columns) };
+        }
+
+        string_view last = text.substr(text.rfind('\n') + 1);
+        const size_t columns = codePoints ? simd::Active().countCodePoints(last.data(), last.size()) : last.size();
+        return { static_cast<int>(t.line + newlines), static_cast<int>(columns + 1) };
+    }
+
+    string_view CompactTokenStream::Message(size_t tokenIndex) const {
+        auto it = lower_bound(diagnostics.begin(), diagnostics.end(), tokenIndex,
+            [](const TokenDiagnostic& d, size_t index) { return d.token < index; });
+
+        if (it != diagnostics.end() && it->token == tokenIndex) return it->message;
+        return {};
+    }
+
+    Token CompactTokenStream::Materialize(size_t tokenIndex) const {
+        const CompactToken& t = tokens[tokenIndex];
+        return Token{ t.Kind(), string(Lexeme(t)), t.Pos(), string(Message(tokenIndex)),
+            tokenIndex < symbols.size() ? symbols[tokenIndex] : kNoSymbol };
+    }
 } 
@@ -0,0 +1,156 @@
+#include "lexer/TokenCache.hpp"
+#include "lexer/Hash.hpp"
+#include "lexer/SymbolTable.hpp"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <filesystem>
+#include <vector>
+#ifdef _WIN32
+#include <process.h>
+#define getpid _getpid
+#else
+#include <unistd.h>
+#endif
+using namespace std;
+namespace fs = std::filesystem;
+
+namespace clex {
+
+    namespace {
+
+        constexpr const char* kEntryExtension = ".clxt";
+
+        // A writer that died between creating its temp file and renaming it leaves
+        // the file behind; eviction sweeps those once they are this old.
+        constexpr auto kStaleTempAge = chrono::hours(1);
+
+        atomic<uint64_t> tempCounter{ 0 };
+
+        struct Entry {
+            fs::path           path;
+            uint64_t           size;
+            fs::file_time_type used;
+        };
+
+        // Only what changes the produced tokens goes into the key: both engines
+        // emit the same stream, so the engine is left out.
+        uint64_t OptionsSeed(const LexerOptions& options) {
+            const uint32_t fields[] = { kLexerVersion, static_cast<uint32_t>(options.standard), options.trackPositions,
+                                        options.recoverFromErrors, static_cast<uint32_t>(options.recoverFromErrors ? options.maxErrors : 0),
+                                        options.codePointColumns };
+            return HashBytes(string_view(reinterpret_cast<const char*>(fields), sizeof(fields)));
+        }
+
+    }
+
+    TokenCache::TokenCache(string directory, uint64_t maxBytes)
+        : directory_(move(directory)), maxBytes_(maxBytes) {}
+
+    string TokenCache::EntryPath(string_view source, const LexerOptions& options) const {
+        char name[32];
+        snprintf(name, sizeof(name), "%016llx", static_cast<unsigned long long>(HashBytes(source, OptionsSeed(options))));
+        return (fs::path(directory_) / (string(name) + kEntryExtension)).string();
+    }
+
+    bool TokenCache::Lookup(string_view source, const LexerOptions& options, TokenFile& file, CompactTokenStream& stream) {
+        string path = EntryPath(source, options);
+        if (!file.Open(path) || file.HasSource() || file.TokenCount() == 0) return false;
+
+        // A hash collision, a corrupt entry or one from another build could hand
+        // out lexemes past the end of `source`; any bad record is a miss. Records
+        // are checked where they are mapped, so a miss copies nothing.
+        uint32_t previous = 0;
+        for (size_t i = 0; i < file.TokenCount(); ++i) {
+            const CompactToken t = file.At(i);
+            if (t.offset < previous || static_cast<uint64_t>(t.offset) + t.length > source.size() || t.kind >= kTokenKindCount) return false;
+            previous = t.offset;
+        }
+
+        stream = file.ToStream();
+        stream.source = source;
+        if (options.symbols) InternIdentifiers(stream, *options.symbols);
+
+        error_code ec;
+        fs::last_write_time(path, fs::file_time_type::clock::now(), ec);
+        return true;
+    }
+
+    bool TokenCache::Store(string_view source, const LexerOptions& options, const CompactTokenStream& stream) {
+        string blob;
+        tokenfile::Encode(stream, false, blob);
+
+        error_code ec;
+        fs::create_directories(directory_, ec);
+
+        string path = EntryPath(source, options);
+        string temp = path + ".tmp-" + std::to_string(getpid()) + "-" + std::to_string(tempCounter++);
+
+        FILE* out = fopen(temp.c_str(), "wb");
+        if (!out) return false;
+        bool written = fwrite(blob.data(), 1, blob.size(), out) == blob.size();
+        written = fclose(out) == 0 && written;
+
+        // Renaming over an entry another process just stored replaces identical bytes.
+        if (written) fs::rename(temp, path, ec);
+        if (!written || ec) {
+            fs::remove(temp, ec);
+            return false;
+        }
+
+        bool evict;
+        {
+            lock_guard<mutex> guard(lock_);
+            if (scanned_) knownBytes_ += blob.size();
+            evict = !scanned_ || knownBytes_ > maxBytes_;
+        }
+
+        if (evict) Evict();
+        return true;
+    }
+
+    void TokenCache::Evict() {
+        vector<Entry> entries;
+        uint64_t total = 0;
+        const auto now = fs::file_time_type::clock::now();
+
+        error_code ec;
+        for (fs::directory_iterator it(directory_, ec), end; !ec && it != end; it.increment(ec)) {
+            error_code entryEc;
+            if (!it->is_regular_file(entryEc)) continue;
+
+            const fs::path& p = it->path();
+            fs::file_time_type used = it->last_write_time(entryEc);
+            if (entryEc) continue;
+
+            if (p.filename().string().find(".tmp-") != string::npos) {
+                if (now - used > kStaleTempAge) fs::remove(p, entryEc);
+                continue;
+            }
+            if (p.extension() != kEntryExtension) continue;
+
+            uint64_t size = it->file_size(entryEc);
+            if (entryEc) continue;
+
+            entries.push_back({ p, size, used });
+            total += size;
+        }
+
+        // Trim to 90% of the bound so a full cache is not rescanned on every store.
+        if (total > maxBytes_) {
+            sort(entries.begin(), entries.end(), [](const Entry& a, const Entry& b) { return a.used < b.used; });
+
+            const uint64_t target = maxBytes_ / 10 * 9;
+            for (const Entry& e : entries) {
+                if (total <= target) break;
+                if (fs::remove(e.path, ec)) total -= e.size;
+            }
+        }
+
+        lock_guard<mutex> guard(lock_);
+        knownBytes_ = total;
+        scanned_ = true;
+    }
+
+}
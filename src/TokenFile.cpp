@@ -0,0 +1,167 @@
+#include "lexer/TokenFile.hpp"
+#include <cstddef>
+#include <cstring>
+using namespace std;
+
+namespace clex {
+
+    namespace tokenfile {
+
+        namespace {
+
+            size_t MessageBytes(const CompactTokenStream& stream) {
+                size_t bytes = 0;
+                for (const TokenDiagnostic& d : stream.diagnostics) bytes += d.message.size();
+                return bytes;
+            }
+
+            template <class T>
+            char* Put(char* out, const T& value) {
+                memcpy(out, &value, sizeof(T));
+                return out + sizeof(T);
+            }
+
+            // A Record is a CompactToken wherever bit-fields fill a word from its
+            // low bit (GCC, Clang and MSVC alike), so records can be copied whole.
+            bool RecordsAreTokens() {
+                CompactToken t{};
+                t.column = 0x123456;
+                t.kind = 0x78;
+                uint32_t word;
+                memcpy(&word, reinterpret_cast<const char*>(&t) + offsetof(Record, columnAndKind), sizeof(word));
+                return word == 0x78123456u;
+            }
+
+            const bool kRecordsAreTokens = RecordsAreTokens();
+
+        }
+
+        size_t EncodedSize(const CompactTokenStream& stream, bool withSource) {
+            return sizeof(Header)
+                + stream.tokens.size() * sizeof(Record)
+                + stream.diagnostics.size() * sizeof(DiagnosticRecord)
+                + MessageBytes(stream)
+                + (withSource ? stream.source.size() : 0);
+        }
+
+        void Encode(const CompactTokenStream& stream, bool withSource, string& out) {
+            Header header{};
+            memcpy(header.magic, kMagic, sizeof(kMagic));
+            header.version = kVersion;
+            header.recordSize = sizeof(Record);
+            header.flags = withSource ? kHasSource : 0;
+            header.tokenCount = stream.tokens.size();
+            header.diagnosticCount = stream.diagnostics.size();
+            header.messageBytes = MessageBytes(stream);
+            header.sourceBytes = withSource ? stream.source.size() : 0;
+
+            size_t start = out.size();
+            out.resize(start + EncodedSize(stream, withSource));
+            char* p = Put(&out[start], header);
+
+            for (const CompactToken& t : stream.tokens) {
+                p = Put(p, Record{ t.offset, t.length, t.line, t.column | (static_cast<uint32_t>(t.kind) << 24) });
+            }
+
+            uint32_t messageOffset = 0;
+            for (const TokenDiagnostic& d : stream.diagnostics) {
+                p = Put(p, DiagnosticRecord{ d.token, messageOffset, static_cast<uint32_t>(d.message.size()) });
+                messageOffset += static_cast<uint32_t>(d.message.size());
+            }
+
+            for (const TokenDiagnostic& d : stream.diagnostics) {
+                memcpy(p, d.message.data(), d.message.size());
+                p += d.message.size();
+            }
+
+            if (withSource && !stream.source.empty()) memcpy(p, stream.source.data(), stream.source.size());
+        }
+
+    }
+
+    bool TokenFile::Fail(string message) {
+        error_ = move(message);
+        records_ = nullptr;
+        diagnostics_ = nullptr;
+        header_ = {};
+        return false;
+    }
+
+    bool TokenFile::Open(const string& path) {
+        if (!file_.Open(path)) return Fail(file_.Error());
+        return Load(file_.View());
+    }
+
+    bool TokenFile::Load(string_view bytes, size_t* consumed) {
+        using namespace tokenfile;
+
+        if (bytes.size() < sizeof(Header)) return Fail("truncated header");
+        memcpy(&header_, bytes.data(), sizeof(Header));
+
+        if (memcmp(header_.magic, kMagic, sizeof(kMagic)) != 0) return Fail("not a token file");
+        if (header_.version != kVersion || header_.recordSize != sizeof(Record)) return Fail("unsupported token file version");
+
+        // Each section is checked against what is left, so corrupt counts cannot overflow.
+        size_t left = bytes.size() - sizeof(Header);
+        if (header_.tokenCount > left / sizeof(Record)) return Fail("truncated token records");
+        left -= header_.tokenCount * sizeof(Record);
+        if (header_.diagnosticCount > left / sizeof(DiagnosticRecord)) return Fail("truncated diagnostics");
+        left -= header_.diagnosticCount * sizeof(DiagnosticRecord);
+        if (header_.messageBytes > left) return Fail("truncated messages");
+        left -= header_.messageBytes;
+        if (header_.sourceBytes > left) return Fail("truncated source");
+
+        const char* p = bytes.data() + sizeof(Header);
+        records_ = reinterpret_cast<const Record*>(p);
+        p += header_.tokenCount * sizeof(Record);
+        diagnostics_ = reinterpret_cast<const DiagnosticRecord*>(p);
+        p += header_.diagnosticCount * sizeof(DiagnosticRecord);
+        messages_ = string_view(p, static_cast<size_t>(header_.messageBytes));
+        p += header_.messageBytes;
+        source_ = string_view(p, static_cast<size_t>(header_.sourceBytes));
+        p += header_.sourceBytes;
+
+        for (size_t i = 0; i < header_.diagnosticCount; ++i) {
+            DiagnosticRecord d;
+            memcpy(&d, &diagnostics_[i], sizeof(d));
+            if (d.token >= header_.tokenCount || d.messageOffset > messages_.size() || d.messageLength > messages_.size() - d.messageOffset) {
+                return Fail("corrupt diagnostic record");
+            }
+        }
+
+        if (consumed) *consumed = static_cast<size_t>(p - bytes.data());
+        error_.clear();
+        return true;
+    }
+
+    CompactToken TokenFile::At(size_t index) const {
+        tokenfile::Record r;
+        memcpy(&r, &records_[index], sizeof(r));
+
+        CompactToken t;
+        t.offset = r.offset;
+        t.length = r.length;
+        t.line = r.line;
+        t.column = r.columnAndKind & 0xFFFFFF;
+        t.kind = r.columnAndKind >> 24;
+        return t;
+    }
+
+    CompactTokenStream TokenFile::ToStream() const {
+        CompactTokenStream stream;
+        stream.source = source_;
+
+        stream.tokens.resize(TokenCount());
+        if (tokenfile::kRecordsAreTokens && !stream.tokens.empty()) memcpy(stream.tokens.data(), records_, stream.tokens.size() * sizeof(CompactToken));
+        else for (size_t i = 0; i < stream.tokens.size(); ++i) stream.tokens[i] = At(i);
+
+        stream.diagnostics.reserve(static_cast<size_t>(header_.diagnosticCount));
+        for (size_t i = 0; i < header_.diagnosticCount; ++i) {
+            tokenfile::DiagnosticRecord d;
+            memcpy(&d, &diagnostics_[i], sizeof(d));
+            stream.diagnostics.push_back({ d.token, messages_.substr(d.messageOffset, d.messageLength) });
+        }
+        return stream;
+    }
+
+}
@@ -0,0 +1,281 @@
+#include "lexer/TokenWriter.hpp"
+#include "lexer/TokenFile.hpp"
+#include "lexer/Utf8.hpp"
+#include <charconv>
+#include <cstring>
+using namespace std;
+
+namespace clex {
+
+    namespace {
+
+        // Room for everything a record adds around its lexeme and message.
+        constexpr size_t kRecordOverhead = 160;
+
+        char* Put(char* out, string_view text) {
+            memcpy(out, text.data(), text.size());
+            return out + text.size();
+        }
+
+        char* PutNumber(char* out, uint64_t value) {
+            return to_chars(out, out + 20, value).ptr;
+        }
+
+        // Text output is one record per line, so a directive continued over
+        // several lines is written on one.
+        char* PutOneLine(char* out, string_view text) {
+            for (char c : text) *out++ = (c == '\n' || c == '\r') ? ' ' : c;
+            return out;
+        }
+
+        bool NeedsEscape(unsigned char c) { return c < 0x20 || c == '"' || c == '\\' || c >= 0x80; }
+
+        // Writes `text` as the body of a JSON string; needs up to 6 bytes per input byte.
+        // Well-formed UTF-8 is copied through; any other byte >= 0x80 becomes \u00XX
+        // of its value (i.e. is read as Latin-1), so every line stays valid JSON.
+        char* PutJsonString(char* out, string_view text) {
+            static const char kHex[] = "0123456789abcdef";
+            size_t i = 0;
+
+            while (i < text.size()) {
+                size_t run = i;
+                while (run < text.size() && !NeedsEscape(static_cast<unsigned char>(text[run]))) ++run;
+                out = Put(out, text.substr(i, run - i));
+                if (run == text.size()) break;
+
+                unsigned char c = static_cast<unsigned char>(text[run]);
+                if (c >= 0x80) {
+                    uint32_t cp;
+                    if (size_t n = DecodeUtf8(text.data() + run, text.size() - run, cp)) {
+                        out = Put(out, text.substr(run, n));
+                        i = run + n;
+                        continue;
+                    }
+                }
+
+                *out++ = '\\';
+                switch (c) {
+                case '"':  *out++ = '"'; break;
+                case '\\': *out++ = '\\'; break;
+                case '\n': *out++ = 'n'; break;
+                case '\r': *out++ = 'r'; break;
+                case '\t': *out++ = 't'; break;
+                case '\b': *out++ = 'b'; break;
+                case '\f': *out++ = 'f'; break;
+                default:
+                    out = Put(out, "u00");
+                    *out++ = kHex[c >> 4];
+                    *out++ = kHex[c & 0xF];
+                    break;
+                }
+                i = run + 1;
+            }
+            return out;
+        }
+
+    }
+
+    TokenWriter::TokenWriter(FILE* out, OutputFormat format, size_t bufferSize)
+        : file_(out), format_(format), buffer_(bufferSize, '\0') {}
+
+    TokenWriter::TokenWriter(string& out, OutputFormat format, size_t bufferSize)
+        : target_(&out), format_(format), buffer_(bufferSize, '\0') {}
+
+    TokenWriter::~TokenWriter() { Flush(); }
+
+    void TokenWriter::Drain() {
+        if (used_ == 0) return;
+
+        if (target_) target_->append(buffer_.data(), used_);
+        else if (fwrite(buffer_.data(), 1, used_, file_) != used_) ok_ = false;
+        used_ = 0;
+    }
+
+    bool TokenWriter::Flush() {
+        Drain();
+        if (file_ && fflush(file_) != 0) ok_ = false;
+        return ok_;
+    }
+
+    char* TokenWriter::Reserve(size_t bytes) {
+        if (buffer_.size() - used_ < bytes) {
+            Drain();
+            if (buffer_.size() < bytes) buffer_.resize(bytes);
+        }
+        return &buffer_[used_];
+    }
+
+    void TokenWriter::WriteText(string_view lexeme, TokenKind kind, uint32_t line, uint32_t column, string_view message) {
+        char* p = Reserve(lexeme.size() + message.size() + kRecordOverhead);
+        *p++ = '<';
+        p = Put(p, lexeme);
+        p = Put(p, ", ");
+        p = Put(p, KindName(kind));
+        p = Put(p, ", ");
+        p = PutNumber(p, line);
+        *p++ = ':';
+        p = PutNumber(p, column);
+        *p++ = '>';
+
+        if (!message.empty()) {
+            p = Put(p, " // ");
+            p = Put(p, message);
+        }
+
+        *p++ = '\n';
+        Commit(p);
+    }
+
+    void TokenWriter::WriteJson(string_view lexeme, TokenKind kind, uint32_t line, uint32_t column, string_view message,
+                                const CompactToken* compact) {
+        char* p = Reserve((lexeme.size() + message.size()) * 6 + kRecordOverhead);
+        p = Put(p, "{\"kind\":\"");
+        p = Put(p, KindName(kind));
+        p = Put(p, "\",\"lexeme\":\"");
+        p = PutJsonString(p, lexeme);
+        p = Put(p, "\",\"line\":");
+        p = PutNumber(p, line);
+        p = Put(p, ",\"column\":");
+        p = PutNumber(p, column);
+
+        if (compact) {
+            p = Put(p, ",\"offset\":");
+            p = PutNumber(p, compact->offset);
+            p = Put(p, ",\"length\":");
+            p = PutNumber(p, compact->length);
+        }
+
+        if (!message.empty()) {
+            p = Put(p, ",\"message\":\"");
+            p = PutJsonString(p, message);
+            *p++ = '"';
+        }
+
+        p = Put(p, "}\n");
+        Commit(p);
+    }
+
+    void TokenWriter::Write(const CompactTokenStream& stream, bool withSource) {
+        if (format_ == OutputFormat::Binary) {
+            // Large streams bypass the buffer rather than growing it.
+            Drain();
+            if (target_) {
+                tokenfile::Encode(stream, withSource, *target_);
+                return;
+            }
+
+            string encoded;
+            tokenfile::Encode(stream, withSource, encoded);
+            if (fwrite(encoded.data(), 1, encoded.size(), file_) != encoded.size()) ok_ = false;
+            return;
+        }
+
+        // Diagnostics are sorted by token, so one cursor replaces a search per token.
+        size_t d = 0;
+        for (size_t i = 0; i < stream.tokens.size(); ++i) {
+            const CompactToken& t = stream.tokens[i];
+            string_view message;
+            if (d < stream.diagnostics.size() && stream.diagnostics[d].token == i) message = stream.diagnostics[d++].message;
+
+            if (format_ == OutputFormat::Text) WriteText(stream.Lexeme(t), t.Kind(), t.line, t.column, message);
+            else WriteJson(stream.Lexeme(t), t.Kind(), t.line, t.column, message, &t);
+        }
+    }
+
+    void TokenWriter::Write(const Token& t) {
+        uint32_t line = static_cast<uint32_t>(t.pos.line);
+        uint32_t column = static_cast<uint32_t>(t.pos.column);
+
+        if (format_ == OutputFormat::Text) WriteText(t.lexeme, t.kind, line, column, t.message);
+        else if (format_ == OutputFormat::JsonLines) WriteJson(t.lexeme, t.kind, line, column, t.message, nullptr);
+    }
+
+    void TokenWriter::Write(string_view path, const DependencyRecord& deps) {
+        if (format_ == OutputFormat::Binary) return;
+
+        if (format_ == OutputFormat::Text) {
+            if (!deps.guard.empty()) {
+                char* p = Reserve(path.size() + deps.guard.size() + kRecordOverhead);
+                p = Put(p, path);
+                p = Put(p, ": guard ");
+                p = Put(p, deps.guard);
+                *p++ = '\n';
+                Commit(p);
+            }
+
+            for (const Directive& d : deps.directives) {
+                char* p = Reserve(path.size() + d.name.size() + d.argument.size() + kRecordOverhead);
+                p = Put(p, path);
+                *p++ = ':';
+                p = PutNumber(p, d.line);
+                p = Put(p, ": #");
+                p = Put(p, d.name);
+                if (d.form == IncludeForm::Quoted || d.form == IncludeForm::Angled) {
+                    const bool angled = d.form == IncludeForm::Angled;
+                    p = Put(p, angled ? " <" : " \"");
+                    p = Put(p, d.argument);
+                    *p++ = angled ? '>' : '"';
+                }
+                else if (!d.argument.empty()) {
+                    *p++ = ' ';
+                    p = PutOneLine(p, d.argument);
+                }
+                *p++ = '\n';
+                Commit(p);
+            }
+            return;
+        }
+
+        char* p = Reserve((path.size() + deps.guard.size()) * 6 + kRecordOverhead);
+        p = Put(p, "{\"file\":\"");
+        p = PutJsonString(p, path);
+        if (!deps.guard.empty()) {
+            p = Put(p, "\",\"guard\":\"");
+            p = PutJsonString(p, deps.guard);
+        }
+        p = Put(p, "\",\"includes\":");
+        p = PutNumber(p, deps.IncludeCount());
+        p = Put(p, ",\"directives\":[");
+        Commit(p);
+
+        for (size_t i = 0; i < deps.directives.size(); ++i) {
+            const Directive& d = deps.directives[i];
+            p = Reserve((d.name.size() + d.argument.size()) * 6 + kRecordOverhead);
+            if (i != 0) *p++ = ',';
+            p = Put(p, "{\"line\":");
+            p = PutNumber(p, d.line);
+            p = Put(p, ",\"directive\":\"");
+            p = PutJsonString(p, d.name);
+            if (d.form != IncludeForm::None) {
+                p = Put(p, "\",\"form\":\"");
+                p = Put(p, d.form == IncludeForm::Angled ? "angled" : d.form == IncludeForm::Quoted ? "quoted" : "macro");
+            }
+            p = Put(p, "\",\"argument\":\"");
+            p = PutJsonString(p, d.argument);
+            p = Put(p, "\"}");
+            Commit(p);
+        }
+
+        p = Reserve(8);
+        p = Put(p, "]}\n");
+        Commit(p);
+    }
+
+    void TokenWriter::WriteFileHeader(string_view path) {
+        if (format_ == OutputFormat::Binary) return;
+
+        char* p = Reserve(path.size() * 6 + kRecordOverhead);
+        if (format_ == OutputFormat::Text) {
+            p = Put(p, "==> ");
+            p = Put(p, path);
+            p = Put(p, " <==\n");
+        }
+        else {
+            p = Put(p, "{\"file\":\"");
+            p = PutJsonString(p, path);
+            p = Put(p, "\"}\n");
+        }
+        Commit(p);
+    }
+
+}
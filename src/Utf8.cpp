@@ -0,0 +1,58 @@
+#include "lexer/Utf8.hpp"
+#include "lexer/detail/SimdScan.hpp"
+#include <algorithm>
+using namespace std;
+
+namespace clex {
+
+    namespace {
+
+        struct Range {
+            uint32_t first;
+            uint32_t last;
+        };
+
+        // C11 D.1: characters allowed in identifiers.
+        constexpr Range kAllowed[] = {
+            { 0x00A8, 0x00A8 }, { 0x00AA, 0x00AA }, { 0x00AD, 0x00AD }, { 0x00AF, 0x00AF },
+            { 0x00B2, 0x00B5 }, { 0x00B7, 0x00BA }, { 0x00BC, 0x00BE }, { 0x00C0, 0x00D6 },
+            { 0x00D8, 0x00F6 }, { 0x00F8, 0x00FF }, { 0x0100, 0x167F }, { 0x1681, 0x180D },
+            { 0x180F, 0x1FFF }, { 0x200B, 0x200D }, { 0x202A, 0x202E }, { 0x203F, 0x2040 },
+            { 0x2054, 0x2054 }, { 0x2060, 0x206F }, { 0x2070, 0x218F }, { 0x2460, 0x24FF },
+            { 0x2776, 0x2793 }, { 0x2C00, 0x2DFF }, { 0x2E80, 0x2FFF }, { 0x3004, 0x3007 },
+            { 0x3021, 0x302F }, { 0x3031, 0x303F }, { 0x3040, 0xD7FF }, { 0xF900, 0xFD3D },
+            { 0xFD40, 0xFDCF }, { 0xFDF0, 0xFE44 }, { 0xFE47, 0xFFFD }, { 0x10000, 0x1FFFD },
+            { 0x20000, 0x2FFFD }, { 0x30000, 0x3FFFD }, { 0x40000, 0x4FFFD }, { 0x50000, 0x5FFFD },
+            { 0x60000, 0x6FFFD }, { 0x70000, 0x7FFFD }, { 0x80000, 0x8FFFD }, { 0x90000, 0x9FFFD },
+            { 0xA0000, 0xAFFFD }, { 0xB0000, 0xBFFFD }, { 0xC0000, 0xCFFFD }, { 0xD0000, 0xDFFFD },
+            { 0xE0000, 0xEFFFD },
+        };
+
+        // C11 D.2: combining marks, allowed anywhere but at the start.
+        constexpr Range kNotInitial[] = {
+            { 0x0300, 0x036F }, { 0x1DC0, 0x1DFF }, { 0x20D0, 0x20FF }, { 0xFE20, 0xFE2F },
+        };
+
+        template <size_t N>
+        bool InRanges(const Range (&ranges)[N], uint32_t cp) {
+            auto it = upper_bound(begin(ranges), end(ranges), cp, [](uint32_t c, const Range& r) { return c < r.first; });
+            return it != begin(ranges) && cp <= prev(it)->last;
+        }
+
+    }
+
+    size_t FindInvalidUtf8(string_view text) {
+        size_t bad = simd::Active().validateUtf8(text.data(), text.size());
+        return bad < text.size() ? bad : string_view::npos;
+    }
+
+    size_t CountCodePoints(string_view text) {
+        return simd::Active().countCodePoints(text.data(), text.size());
+    }
+
+    bool IsIdentifierCodePoint(uint32_t cp, bool initial) {
+        if (!InRanges(kAllowed, cp)) return false;
+        return !initial || !InRanges(kNotInitial, cp);
+    }
+
+}
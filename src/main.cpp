@@ -1,43 +1,633 @@
 #include <iostream>
-#include <fstream>
-#include <sstream>
+#include <charconv>
+#include <chrono>
+#include <condition_variable>
+#include <csignal>
+#include <list>
+#include <memory>
+#include <cstdio>
+#include <cstring>
+#include <mutex>
+#include <unordered_map>
+#include <fcntl.h>
+#ifdef _WIN32
+#include <io.h>
+#define open _open
+#define close _close
+#define O_RDONLY (_O_RDONLY | _O_BINARY)
+#else
+#include <unistd.h>
+#endif
+#include "lexer/DependencyScan.hpp"
+#include "lexer/FilePrefetcher.hpp"
+#include "lexer/FileSet.hpp"
+#include "lexer/Hash.hpp"
+#include "lexer/IndexFile.hpp"
+#include "lexer/LexServer.hpp"
 #include "lexer/Lexer.hpp"
+#include "lexer/LexerStats.hpp"
+#include "lexer/LineIndex.hpp"
+#include "lexer/MappedFile.hpp"
+#include "lexer/StreamLexer.hpp"
+#include "lexer/ThreadPool.hpp"
 #include "lexer/Token.hpp"
+#include "lexer/TokenCache.hpp"
+#include "lexer/TokenWriter.hpp"
+#include "lexer/Utf8.hpp"
 using namespace std;
 
+struct CliOptions {
+    clex::LexerOptions lexer;
+    bool               batch = false;
+    bool               parallel = false;
+    bool               scaling = false;
+    bool               stream = false;
+    bool               deps = false;
+    bool               utf8 = false;
+    bool               serve = false;
+    string             socketPath;
+    string             indexPath;
+    vector<string>     queries;
+    clex::OutputFormat format = clex::OutputFormat::Text;
+    bool               stringTable = true;
+    size_t             jobs = 0;
+    size_t             readAhead = 0;
+    bool               ioStats = false;
+    string             cacheDir;
+    size_t             cacheMegabytes = clex::TokenCache::kDefaultMaxBytes >> 20;
+    clex::TokenCache*  cache = nullptr;
+    clex::LexerStats*  stats = nullptr;
+    vector<string>     inputs;
+};
+
 static void PrintUsage(const char* argv0) {
-    cerr << "Usage: " << argv0 << " <file.c>\n";
+    cerr << "Usage: " << argv0 << " [--engine=dispatch|regex] [--std=c89|c99|c11|c23]\n"
+        << "       " << string(strlen(argv0), ' ') << " [--format=text|jsonl|binary] [--no-string-table]\n"
+        << "       " << string(strlen(argv0), ' ') << " [--recover] [--max-errors=N] [--cache=DIR] [--cache-size=MB]\n"
+        << "       " << string(strlen(argv0), ' ') << " [--utf8] [--stats] <file.c | ->\n"
+        << "       " << argv0 << " --stream [options] <file.c | ->\n"
+        << "       " << argv0 << " --parallel [--jobs=N] [options] <file.c>\n"
+        << "       " << argv0 << " --scaling [--jobs=N] [options] <file.c>\n"
+        << "       " << argv0 << " --batch [--jobs=N] [--read-ahead=N] [--io-stats] [options] <file | dir | glob | @list>...\n"
+        << "       " << argv0 << " --deps [--jobs=N] [--format=text|jsonl] <file | dir | glob | @list>...\n"
+        << "       " << argv0 << " --index=FILE [--jobs=N] <file | dir | glob | @list>...\n"
+        << "       " << argv0 << " --index=FILE --query=NAME[*]...\n"
+        << "       " << argv0 << " --serve[=SOCKET] [--jobs=N] [--cache=DIR] [--cache-size=MB]\n";
+}
+
+static bool ParseCount(string_view text, size_t& value) {
+    auto [end, ec] = from_chars(text.data(), text.data() + text.size(), value);
+    return ec == errc() && end == text.data() + text.size();
+}
+
+// "path:line:column: message" for every error, so a recovering run reports them all at once.
+static void AppendDiagnostics(string& out, const string& path, const clex::CompactTokenStream& stream) {
+    for (const clex::TokenDiagnostic& d : stream.diagnostics) {
+        const clex::CompactToken& t = stream.tokens[d.token];
+        out += path + ":" + std::to_string(t.line) + ":" + std::to_string(t.column) + ": " + string(d.message) + "\n";
+    }
+}
+
+static mutex statsLock;
+
+static void AddStats(const CliOptions& cli, const clex::LexerStats& stats) {
+    if (!cli.stats) return;
+    lock_guard<mutex> guard(statsLock);
+    *cli.stats += stats;
+}
+
+// Per-rule report for --stats; cycles are TSC ticks on x86.
+static void PrintStats(const clex::LexerStats& stats) {
+    clex::RuleStats total;
+    for (const clex::RuleStats& r : stats.rules) {
+        total.attempts += r.attempts;
+        total.matches += r.matches;
+        total.bytes += r.bytes;
+        total.cycles += r.cycles;
+        total.allocations += r.allocations;
+    }
+
+    auto row = [&](string_view name, const clex::RuleStats& r) {
+        fprintf(stderr, "%-14.*s %12llu %12llu %14llu %16llu %6.1f%% %10.1f %10llu\n", static_cast<int>(name.size()), name.data(),
+            static_cast<unsigned long long>(r.attempts), static_cast<unsigned long long>(r.matches),
+            static_cast<unsigned long long>(r.bytes), static_cast<unsigned long long>(r.cycles),
+            total.cycles ? 100.0 * r.cycles / total.cycles : 0.0, r.attempts ? double(r.cycles) / r.attempts : 0.0,
+            static_cast<unsigned long long>(r.allocations));
+    };
+
+    fprintf(stderr, "%-14s %12s %12s %14s %16s %7s %10s %10s\n", "rule", "attempts", "matches", "bytes", "cycles", "share", "cyc/try", "allocs");
+    for (size_t i = 0; i < clex::kLexRuleCount; ++i) {
+        const clex::LexRule rule = static_cast<clex::LexRule>(i);
+        if (stats[rule].attempts) row(clex::RuleName(rule), stats[rule]);
+    }
+    row("total", total);
+}
+
+// Lexes `source`, read from `path`, into `out` and returns its exit code: 0 or 2 (Error token).
+static int LexSource(const string& path, string_view source, const CliOptions& cli, clex::TokenWriter& out, string& diagnostics) {
+    // Malformed files are turned away before lexing, as a whole.
+    if (cli.utf8) {
+        const size_t bad = clex::FindInvalidUtf8(source);
+        if (bad != string_view::npos) {
+            const clex::SourcePos pos = clex::LineIndex(source).CodePointPositionOf(source, bad);
+            diagnostics = path + ":" + std::to_string(pos.line) + ":" + std::to_string(pos.column) + ": Invalid UTF-8\n";
+            return 2;
+        }
+    }
+
+    clex::TokenFile cached;
+    clex::CompactTokenStream stream;
+    if (!cli.cache || !cli.cache->Lookup(source, cli.lexer, cached, stream)) {
+        clex::Lexer lexer(source, cli.lexer);
+        stream = cli.parallel ? lexer.TokenizeAllParallel(cli.jobs) : lexer.TokenizeAllCompact();
+        AddStats(cli, lexer.Stats());
+        if (cli.cache) cli.cache->Store(source, cli.lexer, stream);
+    }
+
+    out.Write(stream, cli.stringTable);
+    if (cli.lexer.recoverFromErrors) AppendDiagnostics(diagnostics, path, stream);
+    return stream.diagnostics.empty() ? 0 : 2;
+}
+
+// Lexes one file into `out` and returns its exit code: 0, 1 (unreadable) or 2 (Error token).
+static int LexFile(const string& path, const CliOptions& cli, clex::TokenWriter& out, string& diagnostics) {
+    clex::MappedFile file;
+    if (!file.Open(path)) {
+        diagnostics = "Cannot open: " + path + "\n";
+        return 1;
+    }
+    return LexSource(path, file.View(), cli, out, diagnostics);
+}
+
+// Writes the directives of `source`, read from `path`; returns 0.
+static int ScanSource(const string& path, string_view source, clex::TokenWriter& out) {
+    out.Write(path, clex::ScanDependencies(source));
+    return 0;
+}
+
+// Lexes through a StreamLexer, flushing output as tokens arrive, so memory stays
+// bounded by the largest token even for endless pipes.
+static int RunStream(const CliOptions& cli) {
+    const string& path = cli.inputs[0];
+    int fd = path == "-" ? 0 : open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+        cerr << "Cannot open: " << path << "\n";
+        return 1;
+    }
+
+    clex::FdSource source(fd);
+    clex::StreamLexer lexer(source, cli.lexer);
+
+    clex::TokenWriter out(stdout, cli.format, 64 * 1024);
+    int exitCode = 0;
+    size_t errors = 0;
+    string diagnostics;
+    while (true) {
+        clex::Token t = lexer.GetNextToken();
+        out.Write(t);
+        if (t.kind == clex::TokenKind::EndOfFile) break;
+
+        if (t.kind == clex::TokenKind::Error) {
+            exitCode = 2;
+            if (cli.lexer.recoverFromErrors) {
+                diagnostics += path + ":" + std::to_string(t.pos.line) + ":" + std::to_string(t.pos.column) + ": " + t.message + "\n";
+            }
+            if (cli.lexer.StopAfter(++errors)) break;
+        }
+    }
+
+    out.Flush();
+    fflush(stdout);
+    cerr << diagnostics;
+    AddStats(cli, lexer.Stats());
+    if (fd != 0) close(fd);
+    return exitCode;
+}
+
+static bool SameTokens(const clex::CompactTokenStream& a, const clex::CompactTokenStream& b) {
+    if (a.tokens.size() != b.tokens.size()) return false;
+    for (size_t i = 0; i < a.tokens.size(); ++i) {
+        const clex::CompactToken& x = a.tokens[i];
+        const clex::CompactToken& y = b.tokens[i];
+        if (x.offset != y.offset || x.length != y.length || x.line != y.line || x.column != y.column || x.kind != y.kind) return false;
+    }
+    return true;
+}
+
+// Times TokenizeAllParallel for 1, 2, 4, ... threads against the sequential scan.
+static int RunScaling(const CliOptions& cli) {
+    clex::MappedFile file;
+    if (!file.Open(cli.inputs[0])) {
+        cerr << "Cannot open: " << cli.inputs[0] << "\n";
+        return 1;
+    }
+
+    auto timeRun = [&](size_t threads, clex::CompactTokenStream& out) {
+        double best = 1e30;
+        for (int rep = 0; rep < 3; ++rep) {
+            clex::Lexer lexer(file, cli.lexer);
+            auto t0 = chrono::steady_clock::now();
+            out = threads == 0 ? lexer.TokenizeAllCompact() : lexer.TokenizeAllParallel(threads);
+            best = min(best, chrono::duration<double>(chrono::steady_clock::now() - t0).count());
+        }
+        return best;
+    };
+
+    clex::CompactTokenStream reference, stream;
+    timeRun(0, reference); // warm the page cache and the allocator
+    double sequential = timeRun(0, reference);
+    double mb = file.View().size() / 1e6;
+
+    size_t maxThreads = cli.jobs ? cli.jobs : clex::ThreadPool::DefaultSize();
+    fprintf(stderr, "%-10s %10s %10s %8s\n", "threads", "ms", "MB/s", "speedup");
+    fprintf(stderr, "%-10s %10.2f %10.1f %8.2f\n", "sequential", sequential * 1e3, mb / sequential, 1.0);
+
+    for (size_t threads = 1; ; threads = min(threads * 2, maxThreads)) {
+        double t = timeRun(threads, stream);
+        fprintf(stderr, "%-10zu %10.2f %10.1f %8.2f%s\n", threads, t * 1e3, mb / t, sequential / t,
+            SameTokens(reference, stream) ? "" : "  MISMATCH");
+        if (threads == maxThreads) break;
+    }
+    return 0;
+}
+
+// Lexes (or scans) many files on the pool while a FilePrefetcher reads the
+// next ones, so workers rarely wait on the disk.
+static int RunBatch(const CliOptions& cli) {
+    string error;
+    vector<string> files = clex::ExpandInputs(cli.inputs, error);
+    if (!error.empty()) {
+        cerr << error << "\n";
+        return 1;
+    }
+
+    struct Result {
+        bool   done = false;
+        int    code = 0;
+        string text;
+        string diagnostics;
+        size_t bytes = 0;
+        double readSeconds = 0;
+        double waitSeconds = 0;
+        double lexSeconds = 0;
+    };
+
+    vector<Result> results(files.size());
+    mutex lock;
+    condition_variable ready;
+
+    clex::ThreadPool pool(cli.jobs);
+    clex::FilePrefetcher prefetcher(files, cli.readAhead ? cli.readAhead : 2 * pool.Size());
+    for (size_t n = 0; n < files.size(); ++n) {
+        pool.Submit([&] {
+            clex::PrefetchedFile file;
+            if (!prefetcher.Next(file)) return;
+
+            const size_t i = file.index;
+            Result r;
+            auto t0 = chrono::steady_clock::now();
+            {
+                clex::TokenWriter out(r.text, cli.format);
+                if (!file.error.empty()) {
+                    if (!cli.deps) out.WriteFileHeader(files[i]);
+                    r.diagnostics = "Cannot open: " + files[i] + "\n";
+                    r.code = 1;
+                }
+                else if (cli.deps) r.code = ScanSource(files[i], file.data, out);
+                else {
+                    out.WriteFileHeader(files[i]);
+                    r.code = LexSource(files[i], file.data, cli, out, r.diagnostics);
+                }
+            }
+            r.lexSeconds = chrono::duration<double>(chrono::steady_clock::now() - t0).count();
+            r.bytes = file.data.size();
+            r.readSeconds = file.readSeconds;
+            r.waitSeconds = file.waitSeconds;
+            prefetcher.Release(file);
+            r.done = true;
+
+            lock_guard<mutex> guard(lock);
+            results[i] = move(r);
+            ready.notify_all();
+        });
+    }
+
+    // Results are written strictly in input order while later files keep lexing.
+    if (cli.ioStats) fprintf(stderr, "%-40s %12s %10s %10s %10s\n", "file", "bytes", "read ms", "wait ms", "lex ms");
+    Result total;
+    int exitCode = 0;
+    for (size_t i = 0; i < files.size(); ++i) {
+        Result r;
+        {
+            unique_lock<mutex> guard(lock);
+            ready.wait(guard, [&] { return results[i].done; });
+            r = move(results[i]);
+        }
+
+        fwrite(r.text.data(), 1, r.text.size(), stdout);
+        if (!r.diagnostics.empty()) {
+            fflush(stdout);
+            fputs(r.diagnostics.c_str(), stderr);
+        }
+        if (cli.ioStats) {
+            fprintf(stderr, "%-40s %12zu %10.3f %10.3f %10.3f\n", files[i].c_str(), r.bytes, r.readSeconds * 1e3, r.waitSeconds * 1e3, r.lexSeconds * 1e3);
+            total.bytes += r.bytes;
+            total.readSeconds += r.readSeconds;
+            total.waitSeconds += r.waitSeconds;
+            total.lexSeconds += r.lexSeconds;
+        }
+        exitCode = max(exitCode, r.code);
+    }
+
+    pool.Wait();
+    fflush(stdout);
+    if (cli.ioStats) {
+        fprintf(stderr, "%-40s %12zu %10.3f %10.3f %10.3f\n", "total", total.bytes, total.readSeconds * 1e3, total.waitSeconds * 1e3, total.lexSeconds * 1e3);
+        fprintf(stderr, "read-ahead: %zu files via %s, %zu workers\n", prefetcher.Depth(), prefetcher.BackendName(), pool.Size());
+    }
+    return exitCode;
 }
 
-static void PrintToken(const clex::Token& t) {
-    cout << "<" << t.lexeme << ", " << clex::to_string(t.kind)
-        << ", " << t.pos.line << ":" << t.pos.column << ">";
+// Builds the index, or brings it up to date by lexing only new and changed files.
+static int RunIndex(const CliOptions& cli) {
+    string error;
+    vector<string> files = clex::ExpandInputs(cli.inputs, error);
+    if (!error.empty()) {
+        cerr << error << "\n";
+        return 1;
+    }
 
-    if (!t.message.empty()) cout << " // " << t.message;
+    auto t0 = chrono::steady_clock::now();
+    clex::IndexUpdate update;
+    if (!clex::UpdateIndex(cli.indexPath, files, cli.jobs, update, error)) {
+        cerr << error << "\n";
+        return 1;
+    }
+    double ms = chrono::duration<double, milli>(chrono::steady_clock::now() - t0).count();
 
-    cout << "\n";
+    for (const string& path : update.unreadable) cerr << "Cannot open: " << path << "\n";
+    fprintf(stderr, "%s: %zu files (%zu lexed, %zu reused, %zu removed), %zu terms, %zu postings in %.1f ms\n",
+        cli.indexPath.c_str(), update.lexed + update.reused, update.lexed, update.reused, update.removed,
+        update.terms, update.postings, ms);
+    return update.unreadable.empty() ? 0 : 1;
+}
+
+// Prints "path:line:column: term" for every occurrence; a trailing '*' matches
+// every term with that prefix. Exits with 1 when nothing matched, like grep.
+static int RunQuery(const CliOptions& cli) {
+    clex::IndexFile index;
+    if (!index.Open(cli.indexPath)) {
+        cerr << cli.indexPath << ": " << index.Error() << "\n";
+        return 1;
+    }
+
+    string out;
+    vector<clex::IndexPosting> postings;
+    size_t matches = 0;
+    for (const string& query : cli.queries) {
+        const bool prefix = !query.empty() && query.back() == '*';
+        const string_view name = prefix ? string_view(query).substr(0, query.size() - 1) : string_view(query);
+
+        size_t first = prefix ? index.LowerBound(name) : index.FindTerm(name);
+        for (size_t t = first; t < index.TermCount(); ++t) {
+            string_view term = index.Term(t);
+            if (prefix ? term.substr(0, name.size()) != name : t != first) break;
+
+            postings.clear();
+            if (!index.Postings(t, postings)) {
+                cerr << cli.indexPath << ": corrupt postings for " << term << "\n";
+                return 1;
+            }
+            for (const clex::IndexPosting& p : postings) {
+                out += index.FilePath(p.file);
+                out += ":" + std::to_string(p.line) + ":" + std::to_string(p.column) + ": ";
+                out += term;
+                out += "\n";
+            }
+            matches += postings.size();
+        }
+    }
+
+    fwrite(out.data(), 1, out.size(), stdout);
+    fflush(stdout);
+    return matches ? 0 : 1;
+}
+
+// Applies command-line `args` to `cli`; false on an unknown argument.
+static bool ParseArguments(const vector<string>& args, CliOptions& cli, bool& wantStats) {
+    for (const string& arg : args) {
+        if (arg == "--engine=dispatch") cli.lexer.engine = clex::ScanEngine::Dispatch;
+        else if (arg == "--engine=regex") cli.lexer.engine = clex::ScanEngine::Regex;
+        else if (arg == "--std=c89") cli.lexer.standard = clex::CStandard::C89;
+        else if (arg == "--std=c99") cli.lexer.standard = clex::CStandard::C99;
+        else if (arg == "--std=c11") cli.lexer.standard = clex::CStandard::C11;
+        else if (arg == "--std=c23") cli.lexer.standard = clex::CStandard::C23;
+        else if (arg == "--batch") cli.batch = true;
+        else if (arg == "--parallel") cli.parallel = true;
+        else if (arg == "--scaling") cli.scaling = true;
+        else if (arg == "--stream") cli.stream = true;
+        else if (arg == "--deps") cli.deps = true;
+        else if (arg == "--utf8") cli.utf8 = cli.lexer.codePointColumns = true;
+        else if (arg.rfind("--index=", 0) == 0 && arg.size() > 8) cli.indexPath = arg.substr(8);
+        else if (arg.rfind("--query=", 0) == 0 && arg.size() > 8) cli.queries.push_back(arg.substr(8));
+        else if (arg == "--format=text") cli.format = clex::OutputFormat::Text;
+        else if (arg == "--format=jsonl") cli.format = clex::OutputFormat::JsonLines;
+        else if (arg == "--format=binary") cli.format = clex::OutputFormat::Binary;
+        else if (arg == "--no-string-table") cli.stringTable = false;
+        else if (arg == "--serve") cli.serve = true;
+        else if (arg.rfind("--serve=", 0) == 0 && arg.size() > 8) { cli.serve = true; cli.socketPath = arg.substr(8); }
+        else if (arg == "--stats") wantStats = true;
+        else if (arg == "--recover") cli.lexer.recoverFromErrors = true;
+        else if (arg.rfind("--max-errors=", 0) == 0 && ParseCount(string_view(arg).substr(13), cli.lexer.maxErrors)) cli.lexer.recoverFromErrors = true;
+        else if (arg.rfind("--jobs=", 0) == 0 && ParseCount(string_view(arg).substr(7), cli.jobs)) {}
+        else if (arg.rfind("--read-ahead=", 0) == 0 && ParseCount(string_view(arg).substr(13), cli.readAhead)) {}
+        else if (arg == "--io-stats") cli.ioStats = true;
+        else if (arg.rfind("--cache=", 0) == 0 && arg.size() > 8) cli.cacheDir = arg.substr(8);
+        else if (arg.rfind("--cache-size=", 0) == 0 && ParseCount(string_view(arg).substr(13), cli.cacheMegabytes)) {}
+        else if (arg == "-" || arg.rfind("--", 0) != 0) cli.inputs.push_back(arg);
+        else return false;
+    }
+    return true;
+}
+
+// Recent answers of a serving clexer, keyed by the request's arguments and the
+// bytes it lexed; the least recently used go once they pass `maxBytes`.
+class ResponseCache {
+public:
+    explicit ResponseCache(size_t maxBytes) : maxBytes_(maxBytes) {}
+
+    bool Lookup(uint64_t key, clex::LexResponse& response) {
+        lock_guard<mutex> guard(lock_);
+        auto it = index_.find(key);
+        if (it == index_.end()) return false;
+        entries_.splice(entries_.begin(), entries_, it->second);
+        response = it->second->second;
+        ++hits_;
+        return true;
+    }
+
+    void Store(uint64_t key, const clex::LexResponse& response) {
+        const size_t size = response.out.size() + response.err.size();
+        lock_guard<mutex> guard(lock_);
+        if (size > maxBytes_ || index_.count(key)) return;
+
+        entries_.emplace_front(key, response);
+        index_[key] = entries_.begin();
+        bytes_ += size;
+        while (bytes_ > maxBytes_) {
+            const clex::LexResponse& last = entries_.back().second;
+            bytes_ -= last.out.size() + last.err.size();
+            index_.erase(entries_.back().first);
+            entries_.pop_back();
+        }
+    }
+
+    uint64_t Hits() {
+        lock_guard<mutex> guard(lock_);
+        return hits_;
+    }
+
+private:
+    using Entry = pair<uint64_t, clex::LexResponse>;
+
+    mutex                                         lock_;
+    list<Entry>                                   entries_;
+    unordered_map<uint64_t, list<Entry>::iterator> index_;
+    size_t                                        maxBytes_;
+    size_t                                        bytes_ = 0;
+    uint64_t                                      hits_ = 0;
+};
+
+// The plain "lex one file or stdin" mode, the only one a server answers.
+static bool IsSingleLex(const CliOptions& cli, bool wantStats) {
+    return cli.inputs.size() == 1 && cli.indexPath.empty() && cli.queries.empty() && !cli.batch && !cli.deps &&
+        !cli.stream && !cli.scaling && !cli.serve && !wantStats;
+}
+
+// Answers `request` as clexer would have with the same arguments, from the
+// server's warm caches where possible. Other modes are handed back to the client.
+static void AnswerRequest(const CliOptions& server, ResponseCache& answers, const clex::LexRequest& request, clex::LexResponse& response) {
+    CliOptions cli;
+    bool wantStats = false;
+    if (!ParseArguments(request.args, cli, wantStats) || !IsSingleLex(cli, wantStats) || (cli.inputs[0] == "-") != request.hasInput) {
+        response.exitCode = clex::LexResponse::kRunLocally;
+        return;
+    }
+    // The server's caches stand in for any the request names.
+    cli.cache = server.cache;
+
+    const string& path = cli.inputs[0];
+    clex::MappedFile file;
+    string_view source = request.input;
+    if (!request.hasInput) {
+        const bool relative = !path.empty() && path.front() != '/' && !request.directory.empty();
+        if (!file.Open(relative ? request.directory + "/" + path : path)) {
+            response.exitCode = 1;
+            response.err = "Cannot open: " + path + "\n";
+            return;
+        }
+        source = file.View();
+    }
+
+    uint64_t key = 0;
+    for (const string& arg : request.args) key = clex::HashBytes(arg, key + 1);
+    key = clex::HashBytes(source, key);
+    if (answers.Lookup(key, response)) return;
+
+    {
+        clex::TokenWriter out(response.out, cli.format);
+        response.exitCode = LexSource(path, source, cli, out, response.err);
+    }
+    answers.Store(key, response);
+}
+
+static clex::LexServer* activeServer = nullptr;
+
+static void StopServer(int) {
+    if (activeServer) activeServer->Stop();
+}
+
+// Serves lex requests from clexc until SIGINT or SIGTERM, keeping the regexes,
+// keyword tables and recent answers warm between calls.
+static int RunServe(const CliOptions& cli) {
+    ResponseCache answers(static_cast<size_t>(cli.cacheMegabytes) << 20);
+    const string socketPath = cli.socketPath.empty() ? clex::DefaultSocketPath() : cli.socketPath;
+    clex::LexServer server(socketPath, [&](const clex::LexRequest& request, clex::LexResponse& response) {
+        AnswerRequest(cli, answers, request, response);
+    }, cli.jobs);
+
+    activeServer = &server;
+    signal(SIGINT, StopServer);
+    signal(SIGTERM, StopServer);
+#ifdef SIGPIPE
+    signal(SIGPIPE, SIG_IGN);
+#endif
+
+    cerr << "clexer: serving on " << socketPath << "\n";
+    string error;
+    const bool ok = server.Run(error);
+    activeServer = nullptr;
+    if (!ok) {
+        cerr << error << "\n";
+        return 1;
+    }
+    cerr << "clexer: served " << server.Served() << " requests, " << answers.Hits() << " from memory\n";
+    return 0;
 }
 
 int main(int argc, char** argv) {
-    if (argc < 2) { 
-        PrintUsage(argv[0]); return 1; 
+    CliOptions cli;
+    bool wantStats = false;
+
+    if (!ParseArguments(vector<string>(argv + 1, argv + argc), cli, wantStats)) { PrintUsage(argv[0]); return 1; }
+    if (cli.serve && (!cli.inputs.empty() || !cli.indexPath.empty() || !cli.queries.empty() || cli.batch || cli.deps ||
+        cli.stream || cli.scaling || wantStats)) {
+        PrintUsage(argv[0]); return 1;
     }
 
-    ifstream in(argv[1], ios::binary);
-    if (!in) { 
-        cerr << "Cannot open: " << argv[1] << "\n"; return 1; 
+    // A binary stream needs the whole token array up front; directives have no binary form.
+    const bool binary = cli.format == clex::OutputFormat::Binary;
+    if (!cli.indexPath.empty()) {
+        if (cli.queries.empty() == cli.inputs.empty()) { PrintUsage(argv[0]); return 1; }
+        return cli.queries.empty() ? RunIndex(cli) : RunQuery(cli);
+    }
+    if (!cli.serve && (!cli.queries.empty() || cli.inputs.empty() || (!cli.batch && !cli.deps && cli.inputs.size() != 1) || ((cli.stream || cli.deps) && binary))) {
+        PrintUsage(argv[0]); return 1;
     }
 
-    ostringstream buf; 
-    buf << in.rdbuf();
+#ifdef _WIN32
+    if (cli.format == clex::OutputFormat::Binary) _setmode(_fileno(stdout), _O_BINARY);
+#endif
+
+    unique_ptr<clex::TokenCache> cache;
+    if (!cli.cacheDir.empty()) {
+        cache = make_unique<clex::TokenCache>(cli.cacheDir, static_cast<uint64_t>(cli.cacheMegabytes) << 20);
+        cli.cache = cache.get();
+    }
+    if (cli.serve) return RunServe(cli);
 
-    clex::Lexer lexer(buf.str());
-    vector<clex::Token> tokens = lexer.TokenizeAll();
+    clex::LexerStats stats;
+    if (wantStats) {
+        if (!clex::kStatsEnabled) {
+            cerr << "--stats needs a build configured with -DCLEX_STATS=ON\n";
+            return 1;
+        }
+        cli.stats = &stats;
+    }
 
-    bool hasError = false;
-    for (const clex::Token& t : tokens) {
-        PrintToken(t);
-        if (t.kind == clex::TokenKind::Error) hasError = true;
+    int exitCode;
+    if (cli.batch || cli.deps) exitCode = RunBatch(cli);
+    else if (cli.scaling) exitCode = RunScaling(cli);
+    else if (cli.stream) exitCode = RunStream(cli);
+    else {
+        string diagnostics;
+        {
+            clex::TokenWriter out(stdout, cli.format);
+            exitCode = LexFile(cli.inputs[0], cli, out, diagnostics);
+        }
+        cerr << diagnostics;
     }
-    return hasError ? 2 : 0;
+
+    if (cli.stats) PrintStats(stats);
+    return exitCode;
 }
@@ -0,0 +1,67 @@
+#include <cstdio>
+#include <string>
+#include <vector>
+#include "lexer/DependencyScan.hpp"
+using namespace std;
+
+// Checks which '#' ScanDependencies takes for a directive, what it records for
+// each one, and when it reports an include guard.
+
+static int failures = 0;
+
+static void Expect(const char* name, bool ok) {
+    if (!ok) {
+        fprintf(stderr, "FAIL: %s\n", name);
+        ++failures;
+    }
+}
+
+static void CheckGuard(const char* name, string_view source, string_view guard) {
+    Expect(name, clex::ScanDependencies(source).guard == guard);
+}
+
+// Compares the kinds and arguments of the directives found in `source`.
+static void CheckDirectives(const char* name, string_view source, const vector<pair<clex::DirectiveKind, string_view>>& expected) {
+    const clex::DependencyRecord record = clex::ScanDependencies(source);
+    bool ok = record.directives.size() == expected.size();
+    for (size_t i = 0; ok && i < expected.size(); ++i) {
+        ok = record.directives[i].kind == expected[i].first && record.directives[i].argument == expected[i].second;
+    }
+    Expect(name, ok);
+}
+
+int main() {
+    using clex::DirectiveKind;
+
+    CheckGuard("guarded header", "#ifndef A_H\n#define A_H\nint x;\n#endif\n", "A_H");
+    CheckGuard("guard with comments outside", "// a.h\n#ifndef A_H\n#define A_H\nint x;\n#endif /* A_H */\n/* end */\n", "A_H");
+    CheckGuard("guard as #if !defined(X)", "#if !defined(A_H)\n#define A_H\nint x;\n#endif\n", "A_H");
+    CheckGuard("guard as #if !defined X", "#if ! defined A_H\n#define A_H\n#endif\n", "A_H");
+    CheckGuard("guard with nested conditionals", "#ifndef A_H\n#define A_H\n#ifdef B\nint b;\n#else\nint c;\n#endif\n#endif\n", "A_H");
+    CheckGuard("code before the guard", "int y;\n#ifndef A_H\n#define A_H\n#endif\n", "");
+    CheckGuard("code after the guard", "#ifndef A_H\n#define A_H\n#endif\nint y;\n", "");
+    CheckGuard("directive after the guard", "#ifndef A_H\n#define A_H\n#endif\n#include <b.h>\n", "");
+    CheckGuard("#else at guard level", "#ifndef A_H\n#define A_H\n#else\nint y;\n#endif\n", "");
+    CheckGuard("#define of another macro", "#ifndef A_H\n#define B_H\n#endif\n", "");
+    CheckGuard("#if defined(X)", "#if defined(A_H)\n#define A_H\n#endif\n", "");
+
+    CheckDirectives("# after a block comment", "/* c */ #define X 1\n  /* a\n b */ # include <y.h>\n",
+        { { DirectiveKind::Define, "X" }, { DirectiveKind::Include, "y.h" } });
+    CheckDirectives("# after code", "int x = a # b;\nf(); #define X\n", {});
+    CheckDirectives("# in literals", "char* s = \"\\\n#include <x.h>\";\nchar c = '#';\nchar* t = \"#define Y\";\n", {});
+    CheckDirectives("# in comments", "// #include <x.h>\n/*\n#define Y\n*/\n// a \\\n#undef Z\n", {});
+    CheckDirectives("continued directives", "#define A \\\n  B\n#\\\ninclude \\\n\"c.h\"\n#if X && \\\n Y\n#endif\n",
+        { { DirectiveKind::Define, "A" }, { DirectiveKind::Include, "c.h" }, { DirectiveKind::If, "X && \\\n Y" },
+          { DirectiveKind::Endif, "" } });
+    CheckDirectives("include forms", "#include \"a.h\"\n#include <b.h>\n#include HEADER\n#import <c.h>\n",
+        { { DirectiveKind::Include, "a.h" }, { DirectiveKind::Include, "b.h" }, { DirectiveKind::Include, "HEADER" },
+          { DirectiveKind::Import, "c.h" } });
+
+    const clex::DependencyRecord record = clex::ScanDependencies("int x;\n#define A \\\n 1\n\n  #include <b.h>\n");
+    Expect("directive lines", record.directives.size() == 2 && record.directives[0].line == 2 && record.directives[1].line == 5);
+    Expect("directive offsets", record.directives.size() == 2 && record.directives[0].offset == 7 && record.directives[1].offset == 25);
+    Expect("angled form", record.directives.size() == 2 && record.directives[1].form == clex::IncludeForm::Angled);
+
+    if (failures == 0) puts("dependency scan: all checks passed");
+    return failures ? 1 : 0;
+}
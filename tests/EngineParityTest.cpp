@@ -0,0 +1,79 @@
+#include <cstdio>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include "lexer/Lexer.hpp"
+using namespace std;
+
+// Checks that the dispatch scanner and the regex engine produce the same
+// tokens, lexemes, positions and messages, for the example files and for
+// inputs that exercise the corners of each rule.
+
+static int failures = 0;
+
+static bool Same(const vector<clex::Token>& a, const vector<clex::Token>& b) {
+    if (a.size() != b.size()) return false;
+    for (size_t i = 0; i < a.size(); ++i) {
+        const clex::Token& x = a[i];
+        const clex::Token& y = b[i];
+        if (x.kind != y.kind || x.lexeme != y.lexeme || x.pos.line != y.pos.line || x.pos.column != y.pos.column ||
+            x.message != y.message || x.symbol != y.symbol) return false;
+    }
+    return true;
+}
+
+static vector<clex::Token> Tokenize(const string& source, clex::ScanEngine engine, clex::CStandard standard, bool recover) {
+    clex::LexerOptions options;
+    options.engine = engine;
+    options.standard = standard;
+    options.recoverFromErrors = recover;
+    return clex::Lexer(source, options).TokenizeAll();
+}
+
+static void Check(const string& name, const string& source) {
+    for (clex::CStandard standard : { clex::CStandard::C89, clex::CStandard::C11, clex::CStandard::C23 }) {
+        for (bool recover : { false, true }) {
+            if (!Same(Tokenize(source, clex::ScanEngine::Regex, standard, recover),
+                      Tokenize(source, clex::ScanEngine::Dispatch, standard, recover))) {
+                fprintf(stderr, "FAIL: %s (standard %d%s)\n", name.c_str(), static_cast<int>(standard), recover ? ", recovering" : "");
+                ++failures;
+            }
+        }
+    }
+}
+
+int main() {
+    for (const char* file : { "example1.c", "example2.c", "example3.c", "web_server.c" }) {
+        ifstream in(string(CLEX_EXAMPLES_DIR) + "/" + file, ios::binary);
+        if (!in) {
+            fprintf(stderr, "FAIL: cannot read %s\n", file);
+            ++failures;
+            continue;
+        }
+        stringstream text;
+        text << in.rdbuf();
+        Check(file, text.str());
+    }
+
+    Check("empty", "");
+    Check("unterminated string", "char* s = \"abc\nint x;\n");
+    Check("unterminated string at EOF", "char* s = \"abc\\");
+    Check("unterminated char", "char c = 'a\nint x;\n");
+    Check("unterminated comment", "int x; /* never closed\n int y;\n");
+    Check("escapes in literals", "\"a\\\"b\\\\\" '\\'' '\\n' L\"w\" u8\"x\" '\\x41'\n");
+    Check("continued preprocessor lines", "#define A(x) \\\n  ((x) + 1)\n#if A(1) \\\r\n == 2\n#endif\nint a = A(2);\n");
+    Check("stringizing and pasting", "#define S(x) #x\n#define C(a, b) a ## b\nS(y) C(p, q)\n");
+    Check("floats and ints", "0 1 42 0x1F 0XabcU 07 1u 2L 3ul 1. .5 1.5 1e10 1E-3 2.5f 3.0L 0x1p3 1.e+2 5. .e 1..2 0x 08\n");
+    Check("operators", "a+++b a--->b a<<=1 a>>=2 a...b a->b a&&b||c a!=b ~a ^= |= %= ?: ;,{}[]()\n");
+    Check("unknown bytes", "int x = 1 @ 2 ` $y \x7F \x01;\n");
+    Check("non-ASCII", "int caf\xC3\xA9 = 1; // \xE2\x80\x94 comment\nchar* s = \"\xF0\x9F\x98\x80\";\n");
+    Check("invalid UTF-8", "int x\xFF = 1;\n\"\xC3\x28\"\n");
+    Check("BOM", "\xEF\xBB\xBFint main(void) { return 0; }\n");
+    Check("BOM only", "\xEF\xBB\xBF");
+    Check("CRLF", "int a;\r\n/* c\r\n */ char b;\r\n#define X 1\r\n");
+    Check("keywords by standard", "inline restrict _Bool bool true false nullptr static_assert typeof _Atomic auto\n");
+
+    if (failures == 0) puts("engine parity: all checks passed");
+    return failures ? 1 : 0;
+}
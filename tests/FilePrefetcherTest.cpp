@@ -0,0 +1,107 @@
+#include <chrono>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <string>
+#include <vector>
+#include "lexer/FilePrefetcher.hpp"
+
+#ifdef __linux__
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+using namespace std;
+
+// Checks that every file comes back whole and in order, with either backend,
+// and that an io_uring which stops working mid-run hands the remaining files
+// to the pread readers instead of leaving Next() waiting forever.
+
+static int failures = 0;
+
+static void Expect(const char* name, bool ok) {
+    if (!ok) {
+        fprintf(stderr, "FAIL: %s\n", name);
+        ++failures;
+    }
+}
+
+static string Contents(size_t i) {
+    return "int file" + to_string(i) + ";\n" + string(i * 97 % 5000, 'x') + "\n";
+}
+
+// Takes every file from `prefetcher`; `afterFirst` runs once the first one is
+// held and before it is released.
+template <typename AfterFirst>
+static bool ReadAll(clex::FilePrefetcher& prefetcher, size_t count, AfterFirst afterFirst) {
+    bool ok = true;
+    size_t seen = 0;
+    clex::PrefetchedFile file;
+    while (prefetcher.Next(file)) {
+        ok = ok && file.index == seen && file.error.empty() && file.data == Contents(file.index);
+        if (seen++ == 0) afterFirst();
+        prefetcher.Release(file);
+    }
+    return ok && seen == count;
+}
+
+#ifdef __linux__
+// Points the prefetcher's io_uring descriptor at /dev/null, so the next
+// io_uring_enter fails the way a ring torn down by the kernel would.
+static bool BreakRing() {
+    bool broken = false;
+    for (const auto& entry : filesystem::directory_iterator("/proc/self/fd")) {
+        error_code ec;
+        const string target = filesystem::read_symlink(entry.path(), ec).string();
+        if (ec || target.find("io_uring") == string::npos) continue;
+        const int devNull = open("/dev/null", O_RDONLY | O_CLOEXEC);
+        broken = devNull >= 0 && dup2(devNull, stoi(entry.path().filename().string())) >= 0;
+        if (devNull >= 0) close(devNull);
+    }
+    return broken;
+}
+#endif
+
+int main() {
+    const filesystem::path dir = filesystem::temp_directory_path() / ("clex_prefetch_test_" + to_string(chrono::steady_clock::now().time_since_epoch().count()));
+    filesystem::create_directories(dir);
+
+    const size_t count = 40;
+    vector<string> paths;
+    for (size_t i = 0; i < count; ++i) {
+        paths.push_back((dir / ("f" + to_string(i) + ".c")).string());
+        ofstream(paths.back(), ios::binary) << Contents(i);
+    }
+
+    {
+        clex::FilePrefetcher prefetcher(paths, 4, clex::FilePrefetcher::Backend::Threads);
+        Expect("threads backend", ReadAll(prefetcher, count, [] {}));
+    }
+    {
+        clex::FilePrefetcher prefetcher(paths, 4);
+        Expect("default backend", ReadAll(prefetcher, count, [] {}));
+    }
+
+#ifdef __linux__
+    {
+        // A hang here is the failure this guards against.
+        alarm(60);
+        // With one slot the ring thread is waiting for it while the first file
+        // is held, so swapping its descriptor races with nothing.
+        clex::FilePrefetcher prefetcher(paths, 1);
+        if (string(prefetcher.BackendName()) == "io_uring") {
+            bool broken = false;
+            Expect("failing ring", ReadAll(prefetcher, count, [&] { broken = BreakRing(); }));
+            Expect("ring broken", broken);
+            Expect("fallback backend name", string(prefetcher.BackendName()) == "threads");
+        }
+        else {
+            puts("prefetch: io_uring unavailable, skipping the failing-ring check");
+        }
+        alarm(0);
+    }
+#endif
+
+    filesystem::remove_all(dir);
+    if (failures == 0) puts("prefetch: all checks passed");
+    return failures ? 1 : 0;
+}
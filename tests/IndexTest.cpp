@@ -0,0 +1,85 @@
+#include <chrono>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <string>
+#include <vector>
+#include "lexer/IndexFile.hpp"
+using namespace std;
+namespace fs = std::filesystem;
+
+// Builds an index, changes one file and drops another, and checks what the
+// update lexed, kept and removed and the exact postings it ends up with.
+
+static int failures = 0;
+
+static void Expect(const char* name, bool ok) {
+    if (!ok) {
+        fprintf(stderr, "FAIL: %s\n", name);
+        ++failures;
+    }
+}
+
+static void Write(const fs::path& path, const string& text) {
+    ofstream(path, ios::binary) << text;
+}
+
+struct Expected {
+    string   path;
+    uint32_t offset, line, column;
+};
+
+static bool SamePostings(const clex::IndexFile& index, string_view term, const vector<Expected>& expected) {
+    const size_t t = index.FindTerm(term);
+    vector<clex::IndexPosting> postings;
+    if (t == index.TermCount() || !index.Postings(t, postings) || postings.size() != expected.size()) return false;
+    for (size_t i = 0; i < postings.size(); ++i) {
+        const clex::IndexPosting& p = postings[i];
+        const Expected& e = expected[i];
+        if (index.FilePath(p.file) != e.path || p.offset != e.offset || p.line != e.line || p.column != e.column) return false;
+    }
+    return true;
+}
+
+static bool Update(const string& indexPath, const vector<string>& files, clex::IndexUpdate& update) {
+    string error;
+    if (clex::UpdateIndex(indexPath, files, 1, update, error)) return true;
+    fprintf(stderr, "%s\n", error.c_str());
+    return false;
+}
+
+int main() {
+    const fs::path dir = fs::temp_directory_path() / ("clex_index_test_" + to_string(chrono::steady_clock::now().time_since_epoch().count()));
+    fs::create_directories(dir);
+    const string a = (dir / "a.c").string();
+    const string b = (dir / "b.c").string();
+    const string c = (dir / "c.c").string();
+    const string indexPath = (dir / "test.idx").string();
+
+    Write(a, "#define BSIZE 16\nint buf[BSIZE];\n");
+    Write(b, "int x;\n");
+    Write(c, "int BSIZE;\n");
+
+    clex::IndexUpdate update;
+    Expect("first build", Update(indexPath, { a, b, c }, update) && update.lexed == 3 && update.reused == 0 && update.removed == 0);
+
+    // b.c changes, with an mtime that cannot match the indexed one; c.c goes.
+    Write(b, "char y[BSIZE];\n");
+    fs::last_write_time(b, fs::last_write_time(b) + chrono::hours(1));
+    fs::remove(c);
+    Expect("update", Update(indexPath, { a, b }, update) && update.lexed == 1 && update.reused == 1 && update.removed == 1);
+
+    clex::IndexFile index;
+    Expect("open", index.Open(indexPath) && index.FileCount() == 2);
+    Expect("BSIZE postings", SamePostings(index, "BSIZE", { { a, 8, 1, 9 }, { a, 25, 2, 9 }, { b, 7, 1, 8 } }));
+    Expect("directive name postings", SamePostings(index, "define", { { a, 1, 1, 2 } }));
+    Expect("keyword postings", SamePostings(index, "char", { { b, 0, 1, 1 } }));
+    Expect("changed file's old names", index.FindTerm("x") == index.TermCount());
+    Expect("absent term", index.FindTerm("BSIZ") == index.TermCount());
+
+    Expect("unchanged rebuild", Update(indexPath, { a, b }, update) && update.lexed == 0 && update.reused == 2 && update.removed == 0);
+
+    fs::remove_all(dir);
+    if (failures == 0) puts("index: all checks passed");
+    return failures ? 1 : 0;
+}
@@ -0,0 +1,98 @@
+#include <cstdio>
+#include <string>
+#include <utility>
+#include <vector>
+#include "lexer/Lexer.hpp"
+#include "lexer/ThreadPool.hpp"
+using namespace std;
+
+// Checks that TokenizeAllParallel stitches chunks into exactly the stream
+// TokenizeAllCompact produces. Chunks are at least 128 KiB, so each input is a
+// few MiB made mostly of one multi-line construct, and nearly every newline a
+// chunk can start after lies inside it. Strings, char literals and #define
+// lines end at their newline even after a backslash, so only block comments
+// carry a token into the next chunk; the other inputs check the errors and
+// the line numbers around such backslash-newlines.
+
+static int failures = 0;
+
+static bool Same(const clex::CompactTokenStream& a, const clex::CompactTokenStream& b) {
+    if (a.tokens.size() != b.tokens.size() || a.diagnostics.size() != b.diagnostics.size()) return false;
+    for (size_t i = 0; i < a.tokens.size(); ++i) {
+        const clex::CompactToken& x = a.tokens[i];
+        const clex::CompactToken& y = b.tokens[i];
+        if (x.offset != y.offset || x.length != y.length || x.line != y.line || x.column != y.column || x.kind != y.kind) return false;
+    }
+    for (size_t i = 0; i < a.diagnostics.size(); ++i) {
+        if (a.diagnostics[i].token != b.diagnostics[i].token || a.diagnostics[i].message != b.diagnostics[i].message) return false;
+    }
+    return true;
+}
+
+// `piece(i)` repeated until the text is `bytes` long.
+template <typename Piece>
+static string Repeat(size_t bytes, Piece piece) {
+    string text;
+    for (size_t i = 0; text.size() < bytes; ++i) text += piece(i);
+    return text;
+}
+
+static void Check(const char* name, const string& source, clex::ThreadPool& pool, bool stopEarly = false) {
+    clex::LexerOptions recovering;
+    recovering.recoverFromErrors = true;
+    clex::LexerOptions offsetsOnly = recovering;
+    offsetsOnly.trackPositions = false;
+    clex::LexerOptions capped = recovering;
+    capped.maxErrors = 10000;
+    const clex::LexerOptions strict;
+
+    vector<pair<const char*, clex::LexerOptions>> modes { { "recovering", recovering }, { "offsets only", offsetsOnly } };
+    if (stopEarly) modes.insert(modes.end(), { { "max errors", capped }, { "strict", strict } });
+
+    for (const auto& [mode, options] : modes) {
+        clex::Lexer serial(source, options);
+        clex::Lexer parallel(source, options);
+        if (!Same(serial.TokenizeAllCompact(), parallel.TokenizeAllParallel(pool))) {
+            fprintf(stderr, "FAIL: %s (%s)\n", name, mode);
+            ++failures;
+        }
+    }
+}
+
+int main() {
+    // 16 chunks of 128 KiB.
+    const size_t bytes = 2 * 1024 * 1024;
+    clex::ThreadPool pool(4);
+
+    Check("block comments", Repeat(bytes, [](size_t i) {
+        string piece = "int v" + to_string(i) + " = 1; /* comment\n";
+        for (size_t k = 0; k < 40; ++k) piece += " * line " + to_string(k) + " with \"quotes\" and 'ticks' # and //\n";
+        return piece + " * \"a chunk started inside the comment reads a string here */ x++;\n";
+    }), pool);
+
+    Check("continued strings", Repeat(bytes, [](size_t i) {
+        string piece = "const char* s" + to_string(i) + " = \"start\\\n";
+        for (size_t k = 0; k < 40; ++k) piece += "/* not a comment */ \\\" line " + to_string(k) + "\\\n";
+        return piece + "end /* \";\n";
+    }), pool);
+
+    Check("continued char literals", Repeat(bytes, [](size_t i) {
+        return "char c" + to_string(i) + " = '\\\n\\\nx';\nchar d = '\\\n';\n";
+    }), pool);
+
+    Check("continued defines", Repeat(bytes, [](size_t i) {
+        string piece = "#define M" + to_string(i) + "(a, b) \\\n";
+        for (size_t k = 0; k < 40; ++k) piece += "    /* \" ' */ (a) + (b) * " + to_string(k) + " \\\n";
+        return piece + "    0\n";
+    }), pool);
+
+    // Errors in every chunk, and a comment left open at the end.
+    Check("errors", Repeat(bytes, [](size_t i) {
+        string piece = "int e" + to_string(i) + " = 1 @ 2;\nchar* u = \"open\nchar k = 'x\n/*\n";
+        for (size_t k = 0; k < 20; ++k) piece += " line\n";
+        return piece + "*/\n";
+    }) + "/* never closed\n\n", pool, true);
+
+    if (failures == 0) puts("parallel: all checks passed");
+    return failures ? 1 : 0;
+}
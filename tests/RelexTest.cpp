@@ -0,0 +1,46 @@
+#include <cstdio>
+#include <string>
+#include "lexer/Lexer.hpp"
+using namespace std;
+
+// Checks that Relex after an edit yields the same stream as lexing the edited
+// text from scratch, for edits that add or remove a leading UTF-8 BOM.
+
+static bool Same(const clex::CompactTokenStream& a, const clex::CompactTokenStream& b) {
+    if (a.tokens.size() != b.tokens.size() || a.diagnostics.size() != b.diagnostics.size()) return false;
+    for (size_t i = 0; i < a.tokens.size(); ++i) {
+        const clex::CompactToken& x = a.tokens[i];
+        const clex::CompactToken& y = b.tokens[i];
+        if (x.offset != y.offset || x.length != y.length || x.line != y.line || x.column != y.column || x.kind != y.kind) return false;
+    }
+    return true;
+}
+
+static int failures = 0;
+
+static void Check(const char* name, const string& before, const string& after, clex::TextEdit edit) {
+    clex::Lexer oldLexer(before);
+    clex::CompactTokenStream stream = oldLexer.TokenizeAllCompact();
+
+    clex::Lexer lexer(after);
+    lexer.Relex(stream, edit);
+    clex::Lexer full(after);
+    if (!Same(stream, full.TokenizeAllCompact())) {
+        fprintf(stderr, "FAIL: %s\n", name);
+        ++failures;
+    }
+}
+
+int main() {
+    const string bom = "\xEF\xBB\xBF";
+    const string text = "int x;\nchar* s = \"a\";\n";
+
+    Check("insert BOM", text, bom + text, { 0, 0, 3 });
+    Check("remove BOM", bom + text, text, { 0, 3, 0 });
+    Check("insert BOM before whitespace", "  " + text, bom + "  " + text, { 0, 0, 3 });
+    Check("edit after BOM", bom + text, bom + "long" + text.substr(3), { 3, 3, 4 });
+    Check("break BOM", bom + text, "\xEF\xBB" + text, { 2, 1, 0 });
+
+    if (failures == 0) puts("relex: all checks passed");
+    return failures ? 1 : 0;
+}
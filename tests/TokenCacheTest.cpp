@@ -0,0 +1,106 @@
+#include <chrono>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <string>
+#include "lexer/TokenCache.hpp"
+using namespace std;
+namespace fs = std::filesystem;
+
+// Stores a stream, reads it back, then damages the entry in ways a hash
+// collision or a stray write could, each of which must turn the hit into a miss.
+
+static int failures = 0;
+
+static void Expect(const char* name, bool ok) {
+    if (!ok) {
+        fprintf(stderr, "FAIL: %s\n", name);
+        ++failures;
+    }
+}
+
+static bool Same(const clex::CompactTokenStream& a, const clex::CompactTokenStream& b) {
+    if (a.tokens.size() != b.tokens.size() || a.diagnostics.size() != b.diagnostics.size()) return false;
+    for (size_t i = 0; i < a.tokens.size(); ++i) {
+        const clex::CompactToken& x = a.tokens[i];
+        const clex::CompactToken& y = b.tokens[i];
+        if (x.offset != y.offset || x.length != y.length || x.line != y.line || x.column != y.column || x.kind != y.kind) return false;
+    }
+    for (size_t i = 0; i < a.diagnostics.size(); ++i) {
+        if (a.diagnostics[i].token != b.diagnostics[i].token || a.diagnostics[i].message != b.diagnostics[i].message) return false;
+    }
+    return true;
+}
+
+// The single entry in `dir`.
+static fs::path EntryIn(const fs::path& dir) {
+    for (const auto& entry : fs::directory_iterator(dir)) {
+        if (entry.path().extension() == ".clxt") return entry.path();
+    }
+    return {};
+}
+
+// Overwrites 4 bytes of record `index` at `field` (0 offset, 4 length, 12 column and kind).
+static void Patch(const fs::path& entry, size_t index, size_t field, uint32_t value) {
+    fstream f(entry, ios::in | ios::out | ios::binary);
+    f.seekp(static_cast<streamoff>(sizeof(clex::tokenfile::Header) + index * sizeof(clex::tokenfile::Record) + field));
+    f.write(reinterpret_cast<const char*>(&value), sizeof value);
+}
+
+int main() {
+    const fs::path dir = fs::temp_directory_path() / ("clex_cache_test_" + to_string(chrono::steady_clock::now().time_since_epoch().count()));
+    const string source = "int main(void) {\n    return x @ 1; /* done */\n}\n";
+
+    clex::LexerOptions options;
+    options.recoverFromErrors = true;
+    clex::Lexer lexer(source, options);
+    const clex::CompactTokenStream fresh = lexer.TokenizeAllCompact();
+
+    clex::TokenCache cache(dir.string());
+    auto lookup = [&](const string& text) {
+        clex::TokenFile file;
+        clex::CompactTokenStream stream;
+        const bool hit = cache.Lookup(text, options, file, stream);
+        return hit && Same(stream, fresh);
+    };
+
+    Expect("miss before store", !lookup(source));
+    Expect("store", cache.Store(source, options, fresh));
+    Expect("hit", lookup(source));
+    Expect("hit with the same diagnostics", !fresh.diagnostics.empty() && lookup(source));
+
+    clex::LexerOptions other = options;
+    other.standard = clex::CStandard::C89;
+    clex::TokenFile file;
+    clex::CompactTokenStream stream;
+    Expect("other options miss", !cache.Lookup(source, other, file, stream));
+
+    const fs::path entry = EntryIn(dir);
+    Expect("entry written", !entry.empty());
+    if (!entry.empty()) {
+        Patch(entry, 3, 0, static_cast<uint32_t>(source.size()));
+        Expect("offset past the source", !lookup(source));
+        Patch(entry, 3, 0, fresh.tokens[3].offset);
+        Expect("restored entry", lookup(source));
+
+        Patch(entry, 2, 4, 0xFFFFFFFFu);
+        Expect("length past the source", !lookup(source));
+        Patch(entry, 2, 4, fresh.tokens[2].length);
+
+        Patch(entry, 1, 12, 0xFF000001u);
+        Expect("unknown kind", !lookup(source));
+        Patch(entry, 1, 12, fresh.tokens[1].column | (static_cast<uint32_t>(fresh.tokens[1].kind) << 24));
+
+        Patch(entry, 5, 0, 0);
+        Expect("offsets out of order", !lookup(source));
+        Patch(entry, 5, 0, fresh.tokens[5].offset);
+        Expect("restored again", lookup(source));
+
+        fs::resize_file(entry, fs::file_size(entry) - 1);
+        Expect("truncated entry", !lookup(source));
+    }
+
+    fs::remove_all(dir);
+    if (failures == 0) puts("token cache: all checks passed");
+    return failures ? 1 : 0;
+}